@@ -3,60 +3,297 @@
 
 #include <iostream>
 #include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <charconv>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
 #include <thread>
 #include <unordered_set>
+#include <mutex>
+#include <csignal>
 
-#define MAX_BUFFER_SIZE 512
+#define MAX_BUFFER_SIZE (16 * 1024)
+#define CRON_INTERVAL_MS 100
+#define MAX_HEADER_LINE (64 * 1024)        // longest *<argc> or $<len> line accepted
+#define MAX_MULTIBULK_LEN (1024 * 1024)    // arguments per command
+#define MAX_BULK_LEN (512L * 1024 * 1024)  // bytes per argument
 const std::unordered_set<std::string> BLOCKING_COMMANDS = {"BLPOP", "BRPOP", "BRPOPLPUSH"};
 
 CommandExecutor executor{};
+ClientTable clients;
+uint64_t next_client_id = 1;
 
-void handleClient(int epoll_fd, int client_fd) {
-  std::vector<u8> buffer(MAX_BUFFER_SIZE);
-  int numBytesRead = read(client_fd, buffer.data(), buffer.size());
-  
-  if (numBytesRead <= 0) {
-    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
-    close(client_fd);
-    std::cout << "Client disconnected\n";
+// Clients with output the event loop still has to write
+std::unordered_set<int> clients_pending_write;
+
+// Pushes queued by the executor, possibly from a blocking command's thread; the event
+// loop moves them onto the receivers' output queues
+struct PendingPush {
+  std::vector<uint64_t> client_ids;
+  std::shared_ptr<const std::string> payload;
+  bool unblocks = false; // the reply of a blocking command, its client may run commands again
+};
+std::mutex pending_pushes_mutex;
+std::vector<PendingPush> pending_pushes;
+int wakeup_fd = -1; // eventfd that interrupts epoll_wait when the first push is queued
+
+void queuePending(PendingPush push) {
+  bool was_empty;
+  {
+    std::lock_guard<std::mutex> lock(pending_pushes_mutex);
+    was_empty = pending_pushes.empty();
+    pending_pushes.push_back(std::move(push));
+  }
+  if (was_empty) {
+    uint64_t one = 1;
+    write(wakeup_fd, &one, sizeof(one));
   }
-  buffer.resize(numBytesRead); // prevent parser from trying to handle null elements at end of buffer
-  std::cout << "Client connected, reading... \n";
+}
 
-  RespParser parser(buffer);
-  auto client_input_opt = parser.parse();
-  
-  Resp response;
+void queuePush(const std::vector<uint64_t>& client_ids, std::shared_ptr<const std::string> payload) {
+  queuePending({client_ids, std::move(payload)});
+}
+
+void closeClient(int epoll_fd, int client_fd) {
+  auto it = clients.by_fd.find(client_fd);
+  if (it == clients.by_fd.end()) return;
+  epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, NULL);
+  close(client_fd);
+  executor.disconnect(it->second);
+  clients.fd_by_id.erase(it->second.id);
+  clients_pending_write.erase(client_fd);
+  std::erase(clients.to_close, client_fd); // the fd number may be reused right away
+  clients.by_fd.erase(it);
+  std::cout << "Client disconnected\n";
+}
+
+// Writes as much pending output as the socket takes, several buffers per syscall, and
+// only keeps EPOLLOUT registered while something is left
+void flushClient(int epoll_fd, Client& client) {
+  client.sealReply();
+  while (!client.reply_queue.empty()) {
+    struct iovec iov[64];
+    int iov_count = 0;
+    for (auto it = client.reply_queue.begin(); it != client.reply_queue.end() && iov_count < 64; ++it, ++iov_count) {
+      size_t offset = iov_count == 0 ? client.sent_offset : 0;
+      iov[iov_count].iov_base = const_cast<char*>((*it)->data() + offset);
+      iov[iov_count].iov_len = (*it)->size() - offset;
+    }
+    ssize_t written = writev(client.fd, iov, iov_count);
+    if (written < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) clients.scheduleClose(client);
+      break;
+    }
+    client.reply_bytes -= written;
+    client.net_output_bytes += written;
+    size_t left = written;
+    while (left > 0) {
+      size_t chunk_left = client.reply_queue.front()->size() - client.sent_offset;
+      if (left < chunk_left) {
+        client.sent_offset += left;
+        break;
+      }
+      left -= chunk_left;
+      client.sent_offset = 0;
+      client.reply_queue.pop_front();
+    }
+  }
+
+  const bool want_write = !client.reply_queue.empty();
+  if (want_write != client.want_write) {
+    struct epoll_event client_event;
+    client_event.data.fd = client.fd;
+    client_event.events = want_write ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client.fd, &client_event);
+    client.want_write = want_write;
+  }
+}
+
+void processInput(int epoll_fd, Client& client);
+
+// Drops a client whose pending output went over its class's limit
+bool enforceOutputLimit(Client& client, std::chrono::steady_clock::time_point now) {
+  if (client.close_asap || !client.overOutputLimit(executor.client_config(), now)) return false;
+  std::cerr << "Client " << client.id << " closed for overcoming output buffer limits\n";
+  clients.scheduleClose(client);
+  return true;
+}
+
+// Moves queued pushes onto their receivers' output, dropping receivers that went over their limit
+void deliverPushes(int epoll_fd) {
+  std::vector<PendingPush> pushes;
+  {
+    std::lock_guard<std::mutex> lock(pending_pushes_mutex);
+    pushes.swap(pending_pushes);
+  }
+  const auto now = std::chrono::steady_clock::now();
+  for (auto& push : pushes) {
+    for (uint64_t id : push.client_ids) {
+      Client* client = clients.find(id);
+      if (!client || client->close_asap) continue; // disconnected since
+      client->addShared(push.payload);
+      clients_pending_write.insert(client->fd);
+      if (enforceOutputLimit(*client, now)) continue;
+      if (push.unblocks) {
+        // Commands pipelined behind the blocking one waited in the query buffer
+        client->blocked = false;
+        processInput(epoll_fd, *client);
+      }
+    }
+  }
+}
+
+enum class ParseStatus { Complete, Incomplete, Error };
+
+// Reads the number on a "<prefix><number>\r\n" header line at pos, advancing past it
+ParseStatus readHeader(const std::vector<u8>& buf, size_t& pos, char prefix, long& value) {
+  const char* start = reinterpret_cast<const char*>(buf.data()) + pos;
+  const size_t available = buf.size() - pos;
+  const char* cr = static_cast<const char*>(memchr(start, '\r', available));
+  if (!cr || cr + 1 == start + available)
+    return available > MAX_HEADER_LINE ? ParseStatus::Error : ParseStatus::Incomplete;
+  if (*start != prefix || cr[1] != '\n') return ParseStatus::Error;
+  auto [end, ec] = std::from_chars(start + 1, cr, value);
+  if (ec != std::errc() || end != cr) return ParseStatus::Error;
+  pos += cr + 2 - start;
+  return ParseStatus::Complete;
+}
+
+/**
+ * Parses a request (*<argc>\r\n then $<len>\r\n<bytes>\r\n per argument) from the
+ * client's query buffer at pos. Arguments are moved onto the client as they complete and
+ * pos is only advanced past whole headers and arguments, so a command spanning many reads
+ * resumes where the previous read stopped: each byte is parsed once, and while a large
+ * argument arrives only its length is checked.
+ */
+ParseStatus parseCommand(Client& client, size_t& pos) {
+  const std::vector<u8>& buf = client.query_buf;
+  if (client.multibulk_len == 0) {
+    long argc;
+    ParseStatus status = readHeader(buf, pos, '*', argc);
+    if (status != ParseStatus::Complete) return status;
+    if (argc <= 0 || argc > MAX_MULTIBULK_LEN) return ParseStatus::Error;
+    client.multibulk_len = argc;
+    client.partial_args.reserve(std::min<long>(argc, 1024));
+  }
+
+  while (static_cast<long>(client.partial_args.size()) < client.multibulk_len) {
+    if (client.bulk_len < 0) {
+      long len;
+      ParseStatus status = readHeader(buf, pos, '$', len);
+      if (status != ParseStatus::Complete) return status;
+      if (len < 0 || len > MAX_BULK_LEN) return ParseStatus::Error;
+      client.bulk_len = len;
+    }
+    const size_t len = client.bulk_len;
+    if (buf.size() - pos < len + 2) return ParseStatus::Incomplete;
+    if (buf[pos + len] != '\r' || buf[pos + len + 1] != '\n') return ParseStatus::Error;
+    client.partial_args.push_back(Resp::bulkString(std::string(buf.begin() + pos, buf.begin() + pos + len)));
+    client.partial_bytes += len;
+    client.bulk_len = -1;
+    pos += len + 2;
+  }
+  return ParseStatus::Complete;
+}
+
+// Runs the complete commands in the client's query buffer, keeping a trailing partial
+// command's state for the next read. Stops at a blocking command until its reply arrives.
+void processInput(int epoll_fd, Client& client) {
+  size_t consumed = 0;
+
+  // A read may carry several pipelined commands (e.g. MULTI ... EXEC); their replies are
+  // coalesced in the client's output and written together once the read is handled
+  while (!client.blocked && !client.close_asap && consumed < client.query_buf.size()) {
+    ParseStatus status = parseCommand(client, consumed);
+    if (status == ParseStatus::Incomplete) break;
+
+    // invalid commands, the rest of the buffer can't be framed anymore
+    if (status == ParseStatus::Error) {
+      client.addReply(Resp::error("ERR invalid protocol").encode(client.protocol));
+      client.resetPartial();
+      consumed = client.query_buf.size();
+      break;
+    }
+    Resp command = client.takeCommand();
+
+    // handle valid commands
+    std::string cmd_str = command.asArray()[0].asString();
+    CommandExecutor::make_upper(cmd_str);
+    client.last_cmd = cmd_str;
+    if (cmd_str == "CLIENT" && command.asArray().size() > 1)
+      client.last_cmd += "|" + command.asArray()[1].asString();
+    ++client.commands_processed;
+
+    if (BLOCKING_COMMANDS.count(cmd_str) > 0 && !client.in_multi) {
+      if (auto redirection = executor.redirect(command, client)) {
+        client.addReply(redirection->encode(client.protocol));
+        continue;
+      }
+      flushClient(epoll_fd, client); // earlier replies must go out first
+      client.blocked = true;
+      std::thread([id = client.id, command = std::move(command), protocol = client.protocol]() {
+        Resp response = executor.execute(command);
+        queuePending({{id}, std::make_shared<const std::string>(response.encode(protocol)), true});
+      }).detach();
+      continue;
+    }
+    // handle non blocking normally
+    client.addReply(executor.execute(command, client).encode(client.protocol));
+    // A pipelined burst of large replies must not outgrow the limit before the next cron
+    enforceOutputLimit(client, std::chrono::steady_clock::now());
+  }
+
+  client.query_buf.erase(client.query_buf.begin(), client.query_buf.begin() + consumed);
+  if (client.query_buf.empty() && client.query_buf.capacity() > MAX_BUFFER_SIZE)
+    client.query_buf.shrink_to_fit(); // don't keep a large command's buffer around
+  if (client.hasPendingOutput())
+    clients_pending_write.insert(client.fd);
+}
+
+void handleClient(int epoll_fd, int client_fd) {
+  Client& client = clients.by_fd[client_fd];
+  const size_t used = client.query_buf.size();
+  client.query_buf.resize(used + MAX_BUFFER_SIZE);
+  int numBytesRead = read(client_fd, client.query_buf.data() + used, MAX_BUFFER_SIZE);
 
-  // invalid commands
-  if (!client_input_opt || !parser.bufferEmpty() || client_input_opt->type != RespType::Array) {
-    response = Resp::error("ERR invalid protocol");
-    std::string res_str {response.encode()};
-    send(client_fd, res_str.c_str(), res_str.length(), 0);
+  if (numBytesRead <= 0) {
+    closeClient(epoll_fd, client_fd);
     return;
   }
-  // handle valid commands
-  std::string cmd_str = client_input_opt->asArray()[0].asString();
-  CommandExecutor::make_upper(cmd_str);
+  client.query_buf.resize(used + numBytesRead); // prevent parser from trying to handle null elements at end of buffer
+  client.net_input_bytes += numBytesRead;
+  client.last_interaction = std::chrono::steady_clock::now();
 
-  if (BLOCKING_COMMANDS.count(cmd_str) > 0) {
-    std::thread([client_fd, client_input_opt]() {
-      Resp response = executor.execute(*client_input_opt);
-      std::string res_str {response.encode()};
-      send(client_fd, res_str.c_str(), res_str.length(), 0);
-    }).detach();
+  if (client.query_buf.size() + client.partial_bytes > executor.client_config().query_buffer_limit) {
+    std::cerr << "Client " << client.id << " closed for overcoming query buffer limit\n";
+    clients.scheduleClose(client);
     return;
   }
-  // handle non blocking normally
-  response = executor.execute(*client_input_opt);
-  std::string res_str {response.encode()};
-  send(client_fd, res_str.c_str(), res_str.length(), 0);
+  processInput(epoll_fd, client);
+}
+
+// Periodic housekeeping: closes idle clients and clients stuck over their soft output limit
+void clientsCron() {
+  const auto now = std::chrono::steady_clock::now();
+  const auto idle_timeout = executor.client_config().idle_timeout;
+  for (auto& [fd, client] : clients.by_fd) {
+    if (client.close_asap) continue;
+    // Blocked and subscribed clients are expected to sit idle
+    if (idle_timeout.count() > 0 && !client.blocked && !client.isPubSub() &&
+        now - client.last_interaction > idle_timeout) {
+      std::cout << "Client " << client.id << " closed after idle timeout\n";
+      clients.scheduleClose(client);
+      continue;
+    }
+    if (client.hasPendingOutput()) enforceOutputLimit(client, now);
+  }
 }
 
 void connectClient(int epoll_fd, int server_fd) {
@@ -80,14 +317,78 @@ void connectClient(int epoll_fd, int server_fd) {
   client_event.data.fd = client_fd;
   client_event.events = EPOLLIN;
   epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &client_event);
+  Client& client = clients.by_fd[client_fd];
+  client.fd = client_fd;
+  client.id = next_client_id++;
+  char ip[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &client_addr.sin_addr, ip, sizeof(ip));
+  client.addr = std::string(ip) + ":" + std::to_string(ntohs(client_addr.sin_port));
+  clients.fd_by_id[client.id] = client_fd;
 
   std::cout << "Established connection with new client\n";
 }
 
+/**
+ * Parses "host:port,host:port,..." into cluster nodes. Every node of a cluster must be
+ * started with the same list, since the list order decides the initial slot split.
+ */
+std::optional<std::vector<ClusterState::Node>> parseClusterNodes(const std::string& list) {
+  std::vector<ClusterState::Node> nodes;
+  size_t start = 0;
+  while (start <= list.size()) {
+    size_t end = list.find(',', start);
+    if (end == std::string::npos) end = list.size();
+    std::string addr = list.substr(start, end - start);
+    size_t colon = addr.rfind(':');
+    if (colon == std::string::npos) return std::nullopt;
+    try {
+      std::string host = addr.substr(0, colon);
+      int port = std::stoi(addr.substr(colon + 1));
+      nodes.push_back({ClusterState::make_node_id(host, port), host, port});
+    } catch (...) {
+      return std::nullopt;
+    }
+    start = end + 1;
+  }
+  return nodes;
+}
+
 int main(int argc, char **argv) {
   // Flush after every std::cout / std::cerr
   std::cout << std::unitbuf;
   std::cerr << std::unitbuf;
+  // A client vanishing mid-write must surface as EPIPE, not kill the server
+  signal(SIGPIPE, SIG_IGN);
+
+  int port = 6379;
+  std::string cluster_nodes;
+  for (int i{1}; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--port" && i + 1 < argc) {
+      port = std::atoi(argv[++i]);
+    } else if (arg == "--cluster-nodes" && i + 1 < argc) {
+      cluster_nodes = argv[++i];
+    } else {
+      std::cerr << "Unknown argument " << arg << "\n";
+      return 1;
+    }
+  }
+
+  if (!cluster_nodes.empty()) {
+    auto nodes = parseClusterNodes(cluster_nodes);
+    if (!nodes) {
+      std::cerr << "Invalid --cluster-nodes, expected host:port[,host:port...]\n";
+      return 1;
+    }
+    auto self = std::find_if(nodes->begin(), nodes->end(), [&](const auto& node) { return node.port == port; });
+    if (self == nodes->end()) {
+      std::cerr << "--cluster-nodes must include this node's port " << port << "\n";
+      return 1;
+    }
+    int self_idx = self - nodes->begin();
+    executor.enable_cluster(std::move(*nodes), self_idx);
+    std::cout << "Cluster mode enabled, node " << self_idx << "\n";
+  }
   
   int server_fd = socket(AF_INET, SOCK_STREAM, 0);
   if (server_fd < 0) {
@@ -106,10 +407,10 @@ int main(int argc, char **argv) {
   struct sockaddr_in server_addr;
   server_addr.sin_family = AF_INET;
   server_addr.sin_addr.s_addr = INADDR_ANY;
-  server_addr.sin_port = htons(6379);
+  server_addr.sin_port = htons(port);
   
   if (bind(server_fd, (struct sockaddr *) &server_addr, sizeof(server_addr)) != 0) {
-    std::cerr << "Failed to bind to port 6379\n";
+    std::cerr << "Failed to bind to port " << port << "\n";
     return 1;
   }
   
@@ -134,28 +435,66 @@ int main(int argc, char **argv) {
   fcntl(server_fd, F_SETFL, O_NONBLOCK);
   epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &server_event);
 
+  wakeup_fd = eventfd(0, EFD_NONBLOCK);
+  if (wakeup_fd < 0) {
+    std::cerr << "eventfd failed\n";
+    return 1;
+  }
+  struct epoll_event wakeup_event;
+  wakeup_event.data.fd = wakeup_fd;
+  wakeup_event.events = EPOLLIN;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &wakeup_event);
+  executor.set_push_handler(queuePush);
+  executor.set_client_table(&clients);
+  executor.set_listen_port(port);
+  auto last_cron = std::chrono::steady_clock::now();
+
   while (true) {
     struct epoll_event events[64] {};
-    int num_ready = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(epoll_event), -1);
+    int num_ready = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(epoll_event), CRON_INTERVAL_MS);
     
     if (num_ready == -1) {
+      if (errno == EINTR) continue;
       std::cerr << "epoll error.\n";
       break;
-    } else if (num_ready == 0) {
-      std::cerr << "epoll timed out.\n";
-      break;
     }
 
     for (int i{0}; i < num_ready; ++i) {
-      if (events[i].data.fd == server_fd) { // we can accept a new client connection request
+      int fd = events[i].data.fd;
+      if (fd == server_fd) { // we can accept a new client connection request
         connectClient(epoll_fd, server_fd);
       }
-      else { // read() from the client and send() a response
-        handleClient(epoll_fd, events[i].data.fd);
+      else if (fd == wakeup_fd) { // pushes were queued, they are delivered below
+        uint64_t count;
+        read(wakeup_fd, &count, sizeof(count));
       }
+      else {
+        if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) // read() from the client and queue a response
+          handleClient(epoll_fd, fd);
+        if ((events[i].events & EPOLLOUT) && clients.by_fd.count(fd)) // the socket drained, send() more
+          clients_pending_write.insert(fd);
+      }
+    }
+
+    deliverPushes(epoll_fd);
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_cron >= std::chrono::milliseconds(CRON_INTERVAL_MS)) {
+      clientsCron();
+      executor.sample_memory();
+      last_cron = now;
+    }
+    for (int fd : std::vector<int>(clients_pending_write.begin(), clients_pending_write.end())) {
+      auto it = clients.by_fd.find(fd);
+      if (it != clients.by_fd.end() && !it->second.close_asap) flushClient(epoll_fd, it->second);
     }
+    clients_pending_write.clear();
+    // Killed, timed out or over a limit; closed last so no handler above holds a dangling reference
+    std::vector<int> to_close;
+    to_close.swap(clients.to_close);
+    for (int fd : to_close) closeClient(epoll_fd, fd);
 
   }
+  close(wakeup_fd);
   close(epoll_fd);
   close(server_fd);
   return 0;
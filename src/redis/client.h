@@ -0,0 +1,184 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include "../resp/resp.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// A client is disconnected once its pending output reaches hard_bytes, or stays at or
+// above soft_bytes for soft_seconds. A zero limit is disabled.
+struct OutputBufferLimit {
+    size_t hard_bytes;
+    size_t soft_bytes;
+    std::chrono::seconds soft_seconds;
+};
+
+// Per-connection limits, changed at runtime with CONFIG SET
+struct ClientConfig {
+    OutputBufferLimit normal_output{0, 0, std::chrono::seconds(0)};                                  // client-output-buffer-limit normal
+    OutputBufferLimit pubsub_output{32 * 1024 * 1024, 8 * 1024 * 1024, std::chrono::seconds(60)};   // client-output-buffer-limit pubsub
+    size_t query_buffer_limit = 1024 * 1024 * 1024;                                                   // client-query-buffer-limit
+    std::chrono::seconds idle_timeout{0};                                                             // timeout, 0 disables
+};
+
+// Per-connection state, owned by the event loop and keyed by the client's fd
+struct Client {
+    using Clock = std::chrono::steady_clock;
+
+    int fd = -1;
+    uint64_t id = 0;
+    int protocol = 2; // RESP version negotiated with HELLO
+    std::string addr; // ip:port of the peer
+    std::string name; // CLIENT SETNAME
+    Clock::time_point created_at = Clock::now();
+    Clock::time_point last_interaction = Clock::now();
+
+    // Input not parsed yet, possibly ending in a partial command
+    std::vector<u8> query_buf;
+    // A command received across several reads: the arguments parsed so far, how many
+    // are expected (0 between commands) and the length of the bulk argument whose
+    // header was read (-1 if none). Parsing resumes here instead of from the start.
+    RespVec partial_args;
+    size_t partial_bytes = 0;
+    long multibulk_len = 0;
+    long bulk_len = -1;
+    // A blocking command runs on its own thread; input is left unparsed until its reply arrives
+    bool blocked = false;
+
+    // Command stats
+    std::string last_cmd;
+    uint64_t commands_processed = 0;
+    uint64_t net_input_bytes = 0;
+    uint64_t net_output_bytes = 0;
+
+    // CLIENT TRACKING state, the tracked keys/prefixes live in the executor's TrackingTable
+    bool tracking = false;
+    bool tracking_bcast = false;
+
+    bool asking = false; // ASKING was sent, the next command may use an importing slot
+
+    // MULTI/EXEC state
+    bool in_multi = false;
+    bool multi_error = false; // a command was rejected while queueing, EXEC must abort
+    RespVec queued;
+    std::unordered_map<std::string, uint64_t> watched; // key -> version seen at WATCH time
+
+    // Pub/Sub state, mirrored in the executor's PubSub
+    std::unordered_set<std::string> channels;
+    std::unordered_set<std::string> patterns;
+
+    // Output not yet written to the socket. Consecutive replies are coalesced into
+    // reply_buf; fan-out messages are shared buffers queued as-is, never copied.
+    std::deque<std::shared_ptr<const std::string>> reply_queue;
+    std::string reply_buf; // goes out after reply_queue
+    size_t sent_offset = 0; // bytes of reply_queue.front() already written
+    size_t reply_bytes = 0; // total pending output
+    std::optional<std::chrono::steady_clock::time_point> soft_limit_since;
+    bool want_write = false; // EPOLLOUT is registered for the socket
+    bool close_asap = false; // set when the connection must be dropped once control returns to the event loop
+
+    void resetMulti() {
+        in_multi = false;
+        multi_error = false;
+        queued.clear();
+    }
+
+    // Hands over the command whose arguments are all parsed
+    Resp takeCommand() {
+        Resp command = Resp::array(std::move(partial_args));
+        resetPartial();
+        return command;
+    }
+
+    void resetPartial() {
+        partial_args = RespVec();
+        partial_bytes = 0;
+        multibulk_len = 0;
+        bulk_len = -1;
+    }
+
+    bool isPubSub() const { return !channels.empty() || !patterns.empty(); }
+    size_t subscriptionCount() const { return channels.size() + patterns.size(); }
+
+    void addReply(std::string_view bytes) {
+        reply_buf += bytes;
+        reply_bytes += bytes.size();
+    }
+
+    void addShared(std::shared_ptr<const std::string> chunk) {
+        sealReply();
+        reply_bytes += chunk->size();
+        reply_queue.push_back(std::move(chunk));
+    }
+
+    // Moves the coalesced replies into the queue so they keep their place in line
+    void sealReply() {
+        if (reply_buf.empty()) return;
+        reply_queue.push_back(std::make_shared<const std::string>(std::move(reply_buf)));
+        reply_buf.clear();
+    }
+
+    bool hasPendingOutput() const { return reply_bytes > 0; }
+
+    const OutputBufferLimit& outputLimit(const ClientConfig& config) const {
+        return isPubSub() ? config.pubsub_output : config.normal_output;
+    }
+
+    bool overOutputLimit(const ClientConfig& config, Clock::time_point now) {
+        const OutputBufferLimit& limit = outputLimit(config);
+        if (limit.hard_bytes && reply_bytes >= limit.hard_bytes) return true;
+        if (!limit.soft_bytes || reply_bytes < limit.soft_bytes) {
+            soft_limit_since.reset();
+            return false;
+        }
+        if (!soft_limit_since) soft_limit_since = now;
+        return now - *soft_limit_since >= limit.soft_seconds;
+    }
+
+    // Bytes this connection holds on the server: buffers plus transaction and pubsub state.
+    // Shared fan-out buffers are counted in full for every client queueing them.
+    size_t memoryUsage() const {
+        size_t bytes = sizeof(Client) + query_buf.capacity() + reply_buf.capacity();
+        bytes += partial_args.capacity() * sizeof(Resp) + partial_bytes;
+        bytes += reply_bytes - reply_buf.size() + sent_offset; // queued chunks
+        bytes += reply_queue.size() * sizeof(std::shared_ptr<const std::string>);
+        for (const auto& cmd : queued) {
+            for (const auto& arg : cmd.asArray()) bytes += sizeof(Resp) + arg.asString().capacity();
+        }
+        for (const auto& [key, version] : watched) bytes += key.capacity() + sizeof(version);
+        for (const auto& channel : channels) bytes += channel.capacity();
+        for (const auto& pattern : patterns) bytes += pattern.capacity();
+        return bytes;
+    }
+};
+
+// Every connection, owned by the event loop. The executor reads it for CLIENT LIST and
+// flags connections for CLIENT KILL; all access happens on the event loop thread.
+struct ClientTable {
+    std::unordered_map<int, Client> by_fd;
+    std::unordered_map<uint64_t, int> fd_by_id;
+    std::vector<int> to_close; // fds flagged close_asap, closed by the event loop
+
+    Client* find(uint64_t id) {
+        auto it = fd_by_id.find(id);
+        return it == fd_by_id.end() ? nullptr : &by_fd[it->second];
+    }
+
+    void scheduleClose(Client& client) {
+        if (client.close_asap) return;
+        client.close_asap = true;
+        to_close.push_back(client.fd);
+    }
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "cluster.h"
+
+#include <cstdio>
+
+// CRC16-CCITT (XMODEM): polynomial 0x1021, initial value 0, the variant Redis Cluster uses
+static constexpr std::array<uint16_t, 256> make_crc16_table() {
+    std::array<uint16_t, 256> table{};
+    for (int i{0}; i < 256; ++i) {
+        uint16_t crc = i << 8;
+        for (int bit{0}; bit < 8; ++bit)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        table[i] = crc;
+    }
+    return table;
+}
+
+static constexpr std::array<uint16_t, 256> CRC16_TABLE = make_crc16_table();
+
+uint16_t crc16(std::string_view data) noexcept {
+    uint16_t crc = 0;
+    for (unsigned char c : data)
+        crc = (crc << 8) ^ CRC16_TABLE[((crc >> 8) ^ c) & 0xff];
+    return crc;
+}
+
+int key_hash_slot(std::string_view key) noexcept {
+    size_t open = key.find('{');
+    if (open != std::string_view::npos) {
+        size_t close = key.find('}', open + 1);
+        if (close != std::string_view::npos && close != open + 1)
+            key = key.substr(open + 1, close - open - 1);
+    }
+    return crc16(key) & (CLUSTER_SLOTS - 1);
+}
+
+void ClusterState::configure(std::vector<Node> node_list, int self) {
+    nodes = std::move(node_list);
+    myself_idx = self;
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    const int count = nodes.size();
+    for (int i{0}; i < count; ++i) {
+        const int start = i * CLUSTER_SLOTS / count;
+        const int end = (i + 1) * CLUSTER_SLOTS / count;
+        for (int s{start}; s < end; ++s) slots[s] = SlotInfo{i, -1, -1};
+    }
+}
+
+// Node ids must agree across processes without gossip, so they are derived from the address
+std::string ClusterState::make_node_id(const std::string& host, int port) {
+    const std::string addr = host + ":" + std::to_string(port);
+    std::string id;
+    for (uint64_t seed : {0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL, 0x9e3779b97f4a7c15ULL}) {
+        uint64_t h = seed; // FNV-1a
+        for (unsigned char c : addr) {
+            h ^= c;
+            h *= 0x100000001b3ULL;
+        }
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+        id += buf;
+    }
+    return id.substr(0, 40);
+}
+
+std::optional<int> ClusterState::find_node(const std::string& id) const noexcept {
+    for (size_t i{0}; i < nodes.size(); ++i) {
+        if (nodes[i].id == id) return i;
+    }
+    return std::nullopt;
+}
+
+ClusterState::SlotInfo ClusterState::slot(int slot) {
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    return slots[slot];
+}
+
+void ClusterState::set_owner(int slot, int node_idx) {
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    slots[slot] = SlotInfo{node_idx, -1, -1};
+}
+
+void ClusterState::set_migrating(int slot, int node_idx) {
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    slots[slot].migrating_to = node_idx;
+}
+
+void ClusterState::set_importing(int slot, int node_idx) {
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    slots[slot].importing_from = node_idx;
+}
+
+void ClusterState::set_stable(int slot) {
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    slots[slot].migrating_to = -1;
+    slots[slot].importing_from = -1;
+}
+
+// Caller must hold slots_mutex
+std::vector<std::pair<int, int>> ClusterState::owned_ranges(int node_idx) const {
+    std::vector<std::pair<int, int>> ranges;
+    for (int s{0}; s < CLUSTER_SLOTS; ++s) {
+        if (slots[s].owner != node_idx) continue;
+        if (!ranges.empty() && ranges.back().second == s - 1) ranges.back().second = s;
+        else ranges.emplace_back(s, s);
+    }
+    return ranges;
+}
+
+Resp ClusterState::slots_reply() {
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    RespVec reply;
+    for (size_t i{0}; i < nodes.size(); ++i) {
+        for (const auto& [start, end] : owned_ranges(i)) {
+            reply.push_back(Resp::array({
+                Resp::integer(start),
+                Resp::integer(end),
+                Resp::array({Resp::bulkString(nodes[i].host), Resp::integer(nodes[i].port), Resp::bulkString(nodes[i].id)}),
+            }));
+        }
+    }
+    return Resp::array(std::move(reply));
+}
+
+// One line per node in the CLUSTER NODES format; the cluster bus port is reported as port + 10000
+std::string ClusterState::nodes_reply() {
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    std::string reply;
+    for (size_t i{0}; i < nodes.size(); ++i) {
+        const Node& n = nodes[i];
+        reply += n.id + " " + n.host + ":" + std::to_string(n.port) + "@" + std::to_string(n.port + 10000);
+        reply += static_cast<int>(i) == myself_idx ? " myself,master" : " master";
+        reply += " - 0 0 0 connected";
+        for (const auto& [start, end] : owned_ranges(i)) {
+            reply += " " + std::to_string(start);
+            if (end != start) reply += "-" + std::to_string(end);
+        }
+        if (static_cast<int>(i) == myself_idx) {
+            for (int s{0}; s < CLUSTER_SLOTS; ++s) {
+                if (slots[s].migrating_to >= 0)
+                    reply += " [" + std::to_string(s) + "->-" + nodes[slots[s].migrating_to].id + "]";
+                if (slots[s].importing_from >= 0)
+                    reply += " [" + std::to_string(s) + "-<-" + nodes[slots[s].importing_from].id + "]";
+            }
+        }
+        reply += "\n";
+    }
+    return reply;
+}
+
+std::string ClusterState::info_reply() {
+    std::lock_guard<std::mutex> lock(slots_mutex);
+    int assigned = 0;
+    for (const auto& s : slots) {
+        if (s.owner >= 0) ++assigned;
+    }
+    std::string info;
+    info += "cluster_enabled:1\r\n";
+    info += std::string("cluster_state:") + (assigned == CLUSTER_SLOTS ? "ok" : "fail") + "\r\n";
+    info += "cluster_slots_assigned:" + std::to_string(assigned) + "\r\n";
+    info += "cluster_known_nodes:" + std::to_string(nodes.size()) + "\r\n";
+    info += "cluster_size:" + std::to_string(nodes.size()) + "\r\n";
+    info += "cluster_my_id:" + myself().id + "\r\n";
+    return info;
+}
@@ -0,0 +1,72 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include "../resp/resp.h"
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+inline constexpr int CLUSTER_SLOTS = 16384;
+
+uint16_t crc16(std::string_view data) noexcept;
+// CRC16 of the key modulo CLUSTER_SLOTS, hashing only the {tag} part if the key has a non-empty one
+int key_hash_slot(std::string_view key) noexcept;
+
+/**
+ * Cluster topology as seen by this node: the nodes and which of them owns, exports or
+ * imports each hash slot.
+ *
+ * There is no gossip. Every node is started with the same --cluster-nodes list, which
+ * splits the slots evenly in list order, and later changes are applied to each node with
+ * CLUSTER SETSLOT (the way redis-cli --cluster reshard drives a migration).
+ */
+class ClusterState {
+public:
+    struct Node {
+        std::string id;
+        std::string host;
+        int port;
+    };
+    struct SlotInfo {
+        int owner = -1;          // index into nodes, -1 if unassigned
+        int migrating_to = -1;   // set on the owner while the slot moves out
+        int importing_from = -1; // set on the target while the slot moves in
+    };
+
+    // Sets up the node list and the initial even slot split. self is the index of this node.
+    void configure(std::vector<Node> node_list, int self);
+    bool enabled() const noexcept { return !nodes.empty(); }
+
+    static std::string make_node_id(const std::string& host, int port);
+
+    const Node& node(int idx) const { return nodes[idx]; }
+    const Node& myself() const { return nodes[myself_idx]; }
+    int myself_index() const noexcept { return myself_idx; }
+    std::optional<int> find_node(const std::string& id) const noexcept;
+
+    SlotInfo slot(int slot);
+    void set_owner(int slot, int node_idx);
+    void set_migrating(int slot, int node_idx);
+    void set_importing(int slot, int node_idx);
+    void set_stable(int slot);
+
+    Resp slots_reply();
+    std::string nodes_reply();
+    std::string info_reply();
+
+private:
+    // Contiguous [start, end] slot ranges owned by node_idx
+    std::vector<std::pair<int, int>> owned_ranges(int node_idx) const;
+
+    std::vector<Node> nodes; // fixed after configure()
+    int myself_idx = -1;
+    std::array<SlotInfo, CLUSTER_SLOTS> slots{};
+    std::mutex slots_mutex; // protects slots
+};
+
+#endif
@@ -1,23 +1,64 @@
 #include "commands.h"
+#include "glob.h"
 
 #include <stdexcept>
 #include <iostream>
+#include <charconv>
+#include <limits>
+#include <cstring>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+
+thread_local bool CommandExecutor::in_exec = false;
 
 CommandExecutor::CommandExecutor() {
-    commandMap["ECHO"] = [this](const Resp& cmd) { return handle_echo(cmd); };
-    commandMap["PING"] = [this](const Resp& cmd) { return handle_ping(cmd); };
-    commandMap["GET"] = [this](const Resp& cmd) { return handle_get(cmd); };
-    commandMap["SET"] = [this](const Resp& cmd) { return handle_set(cmd); };
-    commandMap["RPUSH"] = [this](const Resp& cmd) { return handle_push(cmd); };
-    commandMap["LPUSH"] = [this](const Resp& cmd) { return handle_push(cmd, false); };
-    commandMap["LRANGE"] = [this](const Resp& cmd) { return handle_lrange(cmd); };
-    commandMap["LLEN"] = [this](const Resp& cmd) { return handle_llen(cmd); };
-    commandMap["LPOP"] = [this](const Resp& cmd) { return handle_lpop(cmd); };
-    commandMap["BLPOP"] = [this](const Resp& cmd) { return handle_blpop(cmd); };
-    commandMap["TYPE"] = [this](const Resp& cmd) { return handle_type(cmd); };
-}
-
-Resp CommandExecutor::execute(const Resp& cmd) const noexcept {
+    commandMap["ECHO"] = {[this](const Resp& cmd) { return handle_echo(cmd); }, -2};
+    commandMap["PING"] = {[this](const Resp& cmd) { return handle_ping(cmd); }, -1};
+    commandMap["GET"] = {[this](const Resp& cmd) { return handle_get(cmd); }, 2, CMD_READONLY, 1, 1, 1};
+    commandMap["SET"] = {[this](const Resp& cmd) { return handle_set(cmd); }, -3, CMD_WRITE, 1, 1, 1};
+    commandMap["RPUSH"] = {[this](const Resp& cmd) { return handle_push(cmd); }, -3, CMD_WRITE, 1, 1, 1};
+    commandMap["LPUSH"] = {[this](const Resp& cmd) { return handle_push(cmd, false); }, -3, CMD_WRITE, 1, 1, 1};
+    commandMap["LRANGE"] = {[this](const Resp& cmd) { return handle_lrange(cmd); }, 4, CMD_READONLY, 1, 1, 1};
+    commandMap["LLEN"] = {[this](const Resp& cmd) { return handle_llen(cmd); }, 2, CMD_READONLY, 1, 1, 1};
+    commandMap["LPOP"] = {[this](const Resp& cmd) { return handle_lpop(cmd); }, -2, CMD_WRITE, 1, 1, 1};
+    commandMap["BLPOP"] = {[this](const Resp& cmd) { return handle_blpop(cmd); }, -2, CMD_WRITE, 1, 1, 1};
+    commandMap["TYPE"] = {[this](const Resp& cmd) { return handle_type(cmd); }, 2, CMD_READONLY, 1, 1, 1};
+    commandMap["DEL"] = {[this](const Resp& cmd) { return handle_del(cmd, false); }, -2, CMD_WRITE, 1, -1, 1};
+    commandMap["UNLINK"] = {[this](const Resp& cmd) { return handle_del(cmd, true); }, -2, CMD_WRITE, 1, -1, 1};
+    commandMap["FLUSHALL"] = {[this](const Resp& cmd) { return handle_flushall(cmd); }, -1, CMD_WRITE};
+    commandMap["FLUSHDB"] = {[this](const Resp& cmd) { return handle_flushall(cmd); }, -1, CMD_WRITE};
+    commandMap["INFO"] = {[this](const Resp& cmd) { return handle_info(cmd); }, -1};
+    commandMap["CONFIG"] = {[this](const Resp& cmd) { return handle_config(cmd); }, -3};
+    // Introspection neither reads nor writes the key, so it leaves access stats alone
+    commandMap["OBJECT"] = {[this](const Resp& cmd) { return handle_object(cmd); }, 3, 0, 2, 2, 1};
+    commandMap["MEMORY"] = {[this](const Resp& cmd) { return handle_memory(cmd); }, -2};
+    commandMap["DEBUG"] = {[this](const Resp& cmd) { return handle_debug(cmd); }, -2, CMD_WRITE};
+    commandMap["SCAN"] = {[this](const Resp& cmd) { return handle_scan(cmd); }, -2, CMD_READONLY};
+    commandMap["KEYS"] = {[this](const Resp& cmd) { return handle_keys(cmd); }, 2, CMD_READONLY};
+    commandMap["PUBLISH"] = {[this](const Resp& cmd) { return handle_publish(cmd); }, 3};
+    commandMap["CLUSTER"] = {[this](const Resp& cmd) { return handle_cluster(cmd); }, -2};
+    commandMap["DUMP"] = {[this](const Resp& cmd) { return handle_dump(cmd); }, 2, CMD_READONLY, 1, 1, 1};
+    commandMap["RESTORE"] = {[this](const Resp& cmd) { return handle_restore(cmd); }, -4, CMD_WRITE, 1, 1, 1};
+    commandMap["RESTORE-ASKING"] = {[this](const Resp& cmd) { return handle_restore(cmd); }, -4, CMD_WRITE | CMD_ASKING, 1, 1, 1};
+    // The keys MIGRATE moves are only known to exist here, so it is never redirected
+    commandMap["MIGRATE"] = {[this](const Resp& cmd) { return handle_migrate(cmd); }, -6, CMD_WRITE};
+
+    startup_memory = allocated_bytes();
+    peak_memory = startup_memory;
+}
+
+const CommandExecutor::Command* CommandExecutor::lookup(const Resp& cmd) const noexcept {
+    std::string cmd_str = cmd.asArray()[0].asString();
+    make_upper(cmd_str);
+    auto it = commandMap.find(cmd_str);
+    return it == commandMap.end() ? nullptr : &it->second;
+}
+
+Resp CommandExecutor::execute(const Resp& cmd) noexcept {
     if (cmd.type != RespType::Array)
         return Resp::error("ERR invalid RESP type, expected non-empty array");
     
@@ -25,14 +66,185 @@ Resp CommandExecutor::execute(const Resp& cmd) const noexcept {
     if (bulk_str_arr.empty())
         return Resp::error("ERR invalid RESP type, expected non-empty array");
     
-    std::string cmd_str = bulk_str_arr[0].asString();
+    // Handlers rely on the command table's arity, so it is enforced for every command
+    if (auto err = validate(cmd)) return *err;
+    const Command* command = lookup(cmd);
+
+    Resp reply = command->func(cmd);
+    // A rejected write changed nothing, so cached copies stay valid
+    if ((command->flags & CMD_WRITE) && reply.type != RespType::Error) {
+        for (const auto& key : command_keys(cmd, *command))
+            invalidate(key);
+    }
+    return reply;
+}
+
+// Commands that act on the connection rather than the keyspace
+const std::unordered_set<std::string> CommandExecutor::CONNECTION_COMMANDS = {"UNWATCH", "HELLO", "CLIENT", "ASKING"};
+
+Resp CommandExecutor::execute_connection(const std::string& cmd_str, const Resp& cmd, Client& client) noexcept {
+    if (cmd_str == "UNWATCH") {
+        std::unique_lock<std::mutex> storage_lock = lock_storage();
+        unwatch_all(client);
+        return Resp::simpleString("OK");
+    }
+    if (cmd_str == "HELLO") return handle_hello(cmd, client);
+    if (cmd_str == "CLIENT") return handle_client(cmd, client);
+    // ASKING
+    if (!cluster.enabled()) return Resp::error("ERR This instance has cluster support disabled");
+    client.asking = true;
+    return Resp::simpleString("OK");
+}
+
+Resp CommandExecutor::execute(const Resp& cmd, Client& client) noexcept {
+    if (cmd.type != RespType::Array || cmd.asArray().empty())
+        return Resp::error("ERR invalid RESP type, expected non-empty array");
+
+    std::string cmd_str = cmd.asArray()[0].asString();
     make_upper(cmd_str);
 
-    auto it = commandMap.find(cmd_str);
-    if (it == commandMap.end())
+    if (cmd_str == "MULTI") return handle_multi(client);
+    if (cmd_str == "EXEC") return handle_exec(client);
+    if (cmd_str == "DISCARD") return handle_discard(client);
+    if (cmd_str == "WATCH") return handle_watch(cmd, client);
+    if (cmd_str == "SUBSCRIBE") return handle_subscribe(cmd, client, false);
+    if (cmd_str == "PSUBSCRIBE") return handle_subscribe(cmd, client, true);
+    if (cmd_str == "UNSUBSCRIBE") return handle_unsubscribe(cmd, client, false);
+    if (cmd_str == "PUNSUBSCRIBE") return handle_unsubscribe(cmd, client, true);
+
+    // RESP2 can't tell pushes from replies, so a subscribed RESP2 connection only takes pubsub
+    // commands. Connection commands are included: HELLO would change the protocol under it.
+    if (client.protocol < 3 && client.isPubSub() && cmd_str != "PING")
+        return Resp::error("ERR Can't execute '" + cmd_str + "': only (P)SUBSCRIBE / (P)UNSUBSCRIBE / PING are allowed in this context");
+
+    if (CONNECTION_COMMANDS.count(cmd_str)) {
+        // Queued like any other command, EXEC runs them with the connection
+        if (!client.in_multi) return execute_connection(cmd_str, cmd, client);
+        client.queued.push_back(cmd);
+        return Resp::simpleString("QUEUED");
+    }
+
+    if (auto redirection = redirect(cmd, client)) {
+        if (client.in_multi) client.multi_error = true;
+        return *redirection;
+    }
+
+    if (!client.in_multi) {
+        // Record before reading so a concurrent write can't slip in unnoticed
+        track_reads(cmd, client);
+        return execute(cmd);
+    }
+
+    // Inside MULTI: validate now so EXEC never runs a half-broken batch
+    if (auto err = validate(cmd)) {
+        client.multi_error = true;
+        return *err;
+    }
+    client.queued.push_back(cmd);
+    return Resp::simpleString("QUEUED");
+}
+
+/**
+ * Checks a command against the command table (existence and arity) without running it.
+ * Returns the error reply if the command would be rejected.
+ */
+std::optional<Resp> CommandExecutor::validate(const Resp& cmd) const noexcept {
+    const RespVec& args = cmd.asArray();
+    std::string cmd_str = args[0].asString();
+    make_upper(cmd_str);
+
+    const Command* command = lookup(cmd);
+    if (!command)
         return Resp::error("ERR invalid command '" + cmd_str + "'");
 
-    return it->second(cmd);
+    const int arity = command->arity;
+    const int argc = args.size();
+    if ((arity > 0 && argc != arity) || (arity < 0 && argc < -arity))
+        return Resp::error("ERR wrong number of arguments for '" + cmd_str + "' command");
+    return std::nullopt;
+}
+
+Resp CommandExecutor::handle_multi(Client& client) noexcept {
+    if (client.in_multi) return Resp::error("ERR MULTI calls can not be nested");
+    client.resetMulti();
+    client.in_multi = true;
+    return Resp::simpleString("OK");
+}
+
+Resp CommandExecutor::handle_exec(Client& client) noexcept {
+    if (!client.in_multi) return Resp::error("ERR EXEC without MULTI");
+
+    if (client.multi_error) {
+        client.resetMulti();
+        std::unique_lock<std::mutex> storage_lock(storage_mutex);
+        unwatch_all(client);
+        return Resp::error("EXECABORT Transaction discarded because of previous errors.");
+    }
+
+    RespVec queued = std::move(client.queued);
+    client.resetMulti();
+
+    // One acquisition for the whole batch: WATCH check and every queued command
+    std::unique_lock<std::mutex> storage_lock(storage_mutex);
+    for (const auto& [key, version] : client.watched) {
+        if (key_version(key) != version) {
+            unwatch_all(client);
+            return Resp::nullArray();
+        }
+    }
+    unwatch_all(client);
+
+    RespVec replies;
+    replies.reserve(queued.size());
+    in_exec = true;
+    for (const auto& cmd : queued) {
+        std::string cmd_str = cmd.asArray()[0].asString();
+        make_upper(cmd_str);
+        if (CONNECTION_COMMANDS.count(cmd_str)) {
+            replies.emplace_back(execute_connection(cmd_str, cmd, client));
+            continue;
+        }
+        replies.emplace_back(execute(cmd));
+        track_reads(cmd, client);
+    }
+    in_exec = false;
+    return Resp::array(std::move(replies));
+}
+
+Resp CommandExecutor::handle_discard(Client& client) noexcept {
+    if (!client.in_multi) return Resp::error("ERR DISCARD without MULTI");
+    client.resetMulti();
+    std::unique_lock<std::mutex> storage_lock(storage_mutex);
+    unwatch_all(client);
+    return Resp::simpleString("OK");
+}
+
+Resp CommandExecutor::handle_watch(const Resp& cmd, Client& client) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() < 2) return Resp::error("ERR invalid number of arguments for WATCH");
+    if (client.in_multi) return Resp::error("ERR WATCH inside MULTI is not allowed");
+
+    std::unique_lock<std::mutex> storage_lock(storage_mutex);
+    for (size_t i{1}; i < args.size(); ++i) {
+        const std::string& key = args[i].asString();
+        if (client.watched.try_emplace(key, key_version(key)).second) ++watch_counts[key];
+    }
+    return Resp::simpleString("OK");
+}
+
+// Forgets the client's watched keys, and the tombstones nobody watches anymore. Caller must hold storage_mutex.
+void CommandExecutor::unwatch_all(Client& client) noexcept {
+    drop_watches(client);
+    client.watched.clear();
+}
+
+void CommandExecutor::drop_watches(const Client& client) noexcept {
+    for (const auto& [key, version] : client.watched) {
+        auto it = watch_counts.find(key);
+        if (it == watch_counts.end() || --it->second > 0) continue;
+        watch_counts.erase(it);
+        tombstones.erase(key);
+    }
 }
 
 Resp CommandExecutor::handle_ping(const Resp& cmd) noexcept {
@@ -61,13 +273,14 @@ Resp CommandExecutor::handle_get(const Resp& cmd) noexcept {
     if (args.size() < 2)
         return Resp::error("ERR invalid number of arguments for 'get'");
 
-    std::unique_lock<std::mutex> storage_lock(storage_mutex);
-    auto it = storage.find(args[1].asString());
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
+    auto it = find_key(args[1].asString());
     if (it == storage.end())
         return Resp::nullBulkString();
     
     if (it->second.isExpired()) {
-        storage.erase(it); 
+        erase_entry(it, true);
+        invalidate(args[1].asString());
         return Resp::nullBulkString();
     }
 
@@ -78,7 +291,7 @@ Resp CommandExecutor::handle_set(const Resp& cmd) noexcept {
     const RespVec& args = cmd.asArray();
     if (args.size() < 3)
         return Resp::error("ERR invalid number of arguments for 'get'");
-    std::unique_lock<std::mutex> storage_lock(storage_mutex);
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
     const std::string& key = args[1].asString();
     const std::string& val = args[2].asString();
     
@@ -102,7 +315,15 @@ Resp CommandExecutor::handle_set(const Resp& cmd) noexcept {
             return Resp::error("ERR unimplemented");
         }
     }
-    storage[key] = entry;
+    touch(entry);
+    auto it = storage.find(key);
+    if (it == storage.end()) {
+        insert_entry(key, std::move(entry));
+    } else {
+        // Hand the old value to lazyfree so overwriting a huge list doesn't stall everyone
+        lazyfree.release(std::move(it->second));
+        it->second = std::move(entry);
+    }
     return Resp::simpleString("OK");
 }
 
@@ -111,21 +332,20 @@ Resp CommandExecutor::handle_push(const Resp& cmd, const bool rPush) noexcept {
     if (args.size() < 2) return Resp::error("ERR invalid number of arguments for RPUSH");
     const std::string& list_key = args[1].asString();
     
-    std::unique_lock<std::mutex> storage_lock(storage_mutex);
-    auto it = storage.find(list_key);
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
+    auto it = find_key(list_key);
     if (it != storage.end() && it->second.type != StorageType::List)
         return Resp::error("ERR " + list_key + " exists and is not a list");
 
-    if (it == storage.end()) {
-        storage[list_key] = StorageEntry{StringList(), StorageType::List};
-        it = storage.find(list_key);
-    }
+    if (it == storage.end())
+        it = insert_entry(list_key, StorageEntry{StringList(), StorageType::List});
     
     auto& list_vals = it->second.asList();
     for (size_t i {2}; i < args.size(); ++i)
         push_string(list_vals, args[i].asString(), rPush);
     int size = list_vals.size();
-    storage_lock.unlock();
+    touch(it->second);
+    if (storage_lock.owns_lock()) storage_lock.unlock();
     {
         std::lock_guard<std::mutex> key_cvs_lock(key_cvs_mutex);
         auto cv_it = key_cvs.find(list_key);
@@ -138,7 +358,7 @@ Resp CommandExecutor::handle_push(const Resp& cmd, const bool rPush) noexcept {
 Resp CommandExecutor::handle_lrange(const Resp& cmd) noexcept {
     const RespVec& args = cmd.asArray();
     if (args.size() != 4) return Resp::error("ERR invalid number of arguments for LRANGE, expected 2 indices");
-    std::unique_lock<std::mutex> storage_lock(storage_mutex);
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
     const std::string& list_key = args[1].asString();
     
     auto start_idx_opt = parse_int(args[2]);
@@ -148,7 +368,7 @@ Resp CommandExecutor::handle_lrange(const Resp& cmd) noexcept {
     int start_idx = *start_idx_opt;
     int end_idx = *end_idx_opt;
 
-    auto it = storage.find(list_key);
+    auto it = find_key(list_key);
     if (it == storage.end()) return Resp::array({});
     if (it->second.type != StorageType::List) return Resp::error("ERR " + list_key + " is not a list");
     
@@ -168,10 +388,10 @@ Resp CommandExecutor::handle_lrange(const Resp& cmd) noexcept {
 Resp CommandExecutor::handle_llen(const Resp& cmd) noexcept {
     const RespVec& args = cmd.asArray();
     if (args.size() != 2) return Resp::error("ERR invalid number of arguments for LLEN");
-    std::unique_lock<std::mutex> storage_lock(storage_mutex);
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
     const std::string& list_key = args[1].asString();
     
-    auto it = storage.find(list_key);
+    auto it = find_key(list_key);
     if (it == storage.end()) return Resp::integer(0);
     if (it->second.type != StorageType::List) return Resp::error("ERR " + list_key + " is not a list");
     return Resp::integer(it->second.asList().size());
@@ -180,7 +400,7 @@ Resp CommandExecutor::handle_llen(const Resp& cmd) noexcept {
 Resp CommandExecutor::handle_lpop(const Resp& cmd) noexcept {
     const RespVec& args = cmd.asArray();
     if (args.size() < 2 || args.size() > 3) return Resp::error("ERR invalid number of arguments for LPOP");
-    std::unique_lock<std::mutex> storage_lock(storage_mutex);
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
     const std::string& list_key = args[1].asString();
     int count = 1;
     if (args.size() == 3) {
@@ -189,7 +409,7 @@ Resp CommandExecutor::handle_lpop(const Resp& cmd) noexcept {
         count = *count_opt;
     }
 
-    auto it = storage.find(list_key);
+    auto it = find_key(list_key);
     if (it == storage.end()) return Resp::nullBulkString();
     if (it->second.type != StorageType::List) return Resp::error("ERR " + list_key + " is not a list");
     
@@ -202,6 +422,7 @@ Resp CommandExecutor::handle_lpop(const Resp& cmd) noexcept {
         list.pop_front();
         --count;
     }
+    touch(it->second);
     if (popped.size() == 1) return std::move(popped[0]);
     return Resp::array(popped);
 }
@@ -209,7 +430,7 @@ Resp CommandExecutor::handle_lpop(const Resp& cmd) noexcept {
 Resp CommandExecutor::handle_blpop(const Resp& cmd) noexcept {
     const RespVec& args = cmd.asArray();
     if (args.size() < 2) return Resp::error("ERR invalid number of arguments for BLPOP");
-    std::unique_lock<std::mutex> storage_lock(storage_mutex);
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
 
     const std::string& list_key = args[1].asString();
     int timeout = 0; // in ms
@@ -217,9 +438,11 @@ Resp CommandExecutor::handle_blpop(const Resp& cmd) noexcept {
         timeout = std::stof(args[2].asString()) * 1000;
     }
 
-    auto it = storage.find(list_key);
+    auto it = find_key(list_key);
     if (it != storage.end() && it->second.type != StorageType::List) return Resp::error("ERR " + list_key + " is not a list");
     if (it == storage.end() || it->second.asList().empty()) {
+        // Inside EXEC we can't release the lock to wait, so behave like a timeout
+        if (!storage_lock.owns_lock()) return Resp::nullArray();
         std::shared_ptr<std::condition_variable> cv;
         {
             std::lock_guard<std::mutex> key_cvs_lock(key_cvs_mutex);
@@ -230,7 +453,7 @@ Resp CommandExecutor::handle_blpop(const Resp& cmd) noexcept {
         }
         auto checkListForItems {
             [&]{ 
-                it = storage.find(list_key);
+                it = find_key(list_key);
                 return it != storage.end() && !it->second.asList().empty();
             }
         };
@@ -246,6 +469,7 @@ Resp CommandExecutor::handle_blpop(const Resp& cmd) noexcept {
     auto& list = it->second.asList();
     const auto popped_str = std::move(list[0]);
     list.pop_front();
+    touch(it->second);
     return Resp::array({Resp::bulkString(list_key), Resp::bulkString(std::move(popped_str))});
 }
 
@@ -253,13 +477,1084 @@ Resp CommandExecutor::handle_type(const Resp& cmd) noexcept {
     const RespVec& args = cmd.asArray();
     if (args.size() != 2) return Resp::error("ERR invalid number of arguments for BLPOP");
 
-    std::unique_lock<std::mutex> storage_lock(storage_mutex);
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
     const std::string& key = args[1].asString();
-    auto it = storage.find(key);
+    auto it = find_key(key);
     if (it == storage.end()) return Resp::simpleString("none");
     return Resp::simpleString(it->second.getTypeName());
 }
 
+/**
+ * HELLO [protover]: switches the connection's RESP version and describes the server.
+ */
+Resp CommandExecutor::handle_hello(const Resp& cmd, Client& client) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() > 1) {
+        auto version = parse_int(args[1]);
+        if (!version) return Resp::error("ERR Protocol version is not an integer or out of range");
+        if (*version != 2 && *version != 3) return Resp::error("NOPROTO unsupported protocol version");
+        // Subscriptions keep the protocol they were made with, so messages would arrive in the old one
+        if (*version != client.protocol && client.isPubSub())
+            return Resp::error("ERR HELLO can't change the protocol of a connection in pub/sub mode");
+        // Invalidations are RESP3 pushes, which a RESP2 client can't parse
+        if (*version < 3 && client.tracking)
+            return Resp::error("ERR HELLO 2 can't be used while CLIENT TRACKING is on, turn it off first");
+        client.protocol = *version;
+    }
+    return Resp::map({
+        Resp::bulkString("server"), Resp::bulkString("redis"),
+        Resp::bulkString("version"), Resp::bulkString("7.2.0"),
+        Resp::bulkString("proto"), Resp::integer(client.protocol),
+        Resp::bulkString("id"), Resp::integer(client.id),
+        Resp::bulkString("mode"), Resp::bulkString("standalone"),
+        Resp::bulkString("role"), Resp::bulkString("master"),
+        Resp::bulkString("modules"), Resp::array({}),
+    });
+}
+
+/**
+ * CLIENT ID
+ * CLIENT INFO
+ * CLIENT LIST [ID id [id ...]]
+ * CLIENT KILL ip:port | CLIENT KILL [ID id] [ADDR ip:port] [SKIPME yes|no]
+ * CLIENT SETNAME name
+ * CLIENT GETNAME
+ * CLIENT TRACKING ON|OFF [BCAST] [PREFIX prefix [PREFIX prefix ...]]
+ */
+Resp CommandExecutor::handle_client(const Resp& cmd, Client& client) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() < 2) return Resp::error("ERR invalid number of arguments for CLIENT");
+    std::string sub = args[1].asString();
+    make_upper(sub);
+
+    if (sub == "ID") return Resp::integer(client.id);
+    if (sub == "INFO") return Resp::bulkString(client_info(client, Client::Clock::now()));
+    if (sub == "LIST") {
+        if (!clients) return Resp::bulkString(client_info(client, Client::Clock::now()));
+        const auto now = Client::Clock::now();
+        std::string list;
+        if (args.size() == 2) {
+            for (const auto& [fd, other] : clients->by_fd) list += client_info(other, now);
+            return Resp::bulkString(std::move(list));
+        }
+        std::string filter = args[2].asString();
+        make_upper(filter);
+        if (filter != "ID" || args.size() < 4) return Resp::error("ERR syntax error");
+        for (size_t i{3}; i < args.size(); ++i) {
+            auto id = parse_int(args[i]);
+            if (!id || *id <= 0) return Resp::error("ERR Invalid client ID");
+            if (const Client* other = clients->find(*id)) list += client_info(*other, now);
+        }
+        return Resp::bulkString(std::move(list));
+    }
+    if (sub == "KILL") return handle_client_kill(cmd, client);
+    if (sub == "SETNAME") {
+        if (args.size() != 3) return Resp::error("ERR invalid number of arguments for CLIENT SETNAME");
+        const std::string& name = args[2].asString();
+        // Names go into the space separated CLIENT LIST output
+        if (std::any_of(name.begin(), name.end(), [](unsigned char c) { return c <= ' ' || c > '~'; }))
+            return Resp::error("ERR Client names cannot contain spaces, newlines or special characters.");
+        client.name = name;
+        return Resp::simpleString("OK");
+    }
+    if (sub == "GETNAME") {
+        if (client.name.empty()) return Resp::nullBulkString();
+        return Resp::bulkString(client.name);
+    }
+    if (sub != "TRACKING") return Resp::error("ERR unknown subcommand '" + args[1].asString() + "'");
+    if (args.size() < 3) return Resp::error("ERR invalid number of arguments for CLIENT TRACKING");
+
+    std::string mode = args[2].asString();
+    make_upper(mode);
+    if (mode == "OFF") {
+        tracking.disable(client.id);
+        client.tracking = false;
+        client.tracking_bcast = false;
+        return Resp::simpleString("OK");
+    }
+    if (mode != "ON") return Resp::error("ERR syntax error");
+    // Invalidations are push messages, which only exist in RESP3
+    if (client.protocol < 3) return Resp::error("ERR CLIENT TRACKING requires RESP3, switch with HELLO 3");
+
+    bool bcast = false;
+    std::vector<std::string> prefixes;
+    for (size_t i{3}; i < args.size(); ++i) {
+        std::string option = args[i].asString();
+        make_upper(option);
+        if (option == "BCAST") {
+            bcast = true;
+        } else if (option == "PREFIX" && i + 1 < args.size()) {
+            prefixes.push_back(args[++i].asString());
+        } else {
+            return Resp::error("ERR syntax error");
+        }
+    }
+    if (!bcast && !prefixes.empty())
+        return Resp::error("ERR PREFIX option requires BCAST mode to be enabled");
+
+    tracking.enable(client.id, bcast, std::move(prefixes));
+    client.tracking = true;
+    client.tracking_bcast = bcast;
+    return Resp::simpleString("OK");
+}
+
+/**
+ * The old form names one address and replies OK, the filter form replies with the
+ * number of clients killed. Killed connections are closed by the event loop once the
+ * current read is handled; the caller itself is skipped unless SKIPME no is given.
+ */
+Resp CommandExecutor::handle_client_kill(const Resp& cmd, Client& client) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() < 3) return Resp::error("ERR invalid number of arguments for CLIENT KILL");
+    if (!clients) return Resp::error("ERR No such client");
+
+    if (args.size() == 3) {
+        for (auto& [fd, other] : clients->by_fd) {
+            if (other.addr != args[2].asString() || other.close_asap) continue;
+            clients->scheduleClose(other);
+            return Resp::simpleString("OK");
+        }
+        return Resp::error("ERR No such client");
+    }
+
+    std::optional<uint64_t> id;
+    std::optional<std::string> addr;
+    bool skip_me = true;
+    for (size_t i{2}; i < args.size(); i += 2) {
+        if (i + 1 >= args.size()) return Resp::error("ERR syntax error");
+        std::string filter = args[i].asString();
+        make_upper(filter);
+        const std::string& value = args[i + 1].asString();
+        if (filter == "ID") {
+            auto parsed = parse_int(args[i + 1]);
+            if (!parsed || *parsed <= 0) return Resp::error("ERR client-id should be greater than 0");
+            id = *parsed;
+        } else if (filter == "ADDR") {
+            addr = value;
+        } else if (filter == "SKIPME") {
+            std::string yes_no = value;
+            make_upper(yes_no);
+            if (yes_no != "YES" && yes_no != "NO") return Resp::error("ERR syntax error");
+            skip_me = yes_no == "YES";
+        } else {
+            return Resp::error("ERR syntax error");
+        }
+    }
+
+    int killed = 0;
+    for (auto& [fd, other] : clients->by_fd) {
+        if (id && other.id != *id) continue;
+        if (addr && other.addr != *addr) continue;
+        if (skip_me && other.id == client.id) continue;
+        if (other.close_asap) continue;
+        clients->scheduleClose(other);
+        ++killed;
+    }
+    return Resp::integer(killed);
+}
+
+/**
+ * One CLIENT LIST line. Flags: N no specific flag, P subscribed, x in MULTI, b blocked,
+ * t tracking, A closing as soon as possible.
+ */
+std::string CommandExecutor::client_info(const Client& client, Client::Clock::time_point now) {
+    using std::chrono::duration_cast;
+    using std::chrono::seconds;
+
+    std::string flags;
+    if (client.isPubSub()) flags += 'P';
+    if (client.in_multi) flags += 'x';
+    if (client.blocked) flags += 'b';
+    if (client.tracking) flags += 't';
+    if (client.close_asap) flags += 'A';
+    if (flags.empty()) flags = "N";
+
+    std::string last_cmd = client.last_cmd.empty() ? "NULL" : client.last_cmd;
+    std::transform(last_cmd.begin(), last_cmd.end(), last_cmd.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    std::string line;
+    line += "id=" + std::to_string(client.id);
+    line += " addr=" + client.addr;
+    line += " fd=" + std::to_string(client.fd);
+    line += " name=" + client.name;
+    line += " age=" + std::to_string(duration_cast<seconds>(now - client.created_at).count());
+    line += " idle=" + std::to_string(duration_cast<seconds>(now - client.last_interaction).count());
+    line += " flags=" + flags;
+    line += " db=0";
+    line += " sub=" + std::to_string(client.channels.size());
+    line += " psub=" + std::to_string(client.patterns.size());
+    line += " multi=" + std::to_string(client.in_multi ? static_cast<long>(client.queued.size()) : -1L);
+    line += " watch=" + std::to_string(client.watched.size());
+    line += " qbuf=" + std::to_string(client.query_buf.size());
+    line += " qbuf-free=" + std::to_string(client.query_buf.capacity() - client.query_buf.size());
+    line += " obl=" + std::to_string(client.reply_buf.size());
+    line += " oll=" + std::to_string(client.reply_queue.size());
+    line += " omem=" + std::to_string(client.reply_bytes);
+    line += " tot-mem=" + std::to_string(client.memoryUsage());
+    line += " cmd=" + last_cmd;
+    line += " resp=" + std::to_string(client.protocol);
+    line += " tot-cmds=" + std::to_string(client.commands_processed);
+    line += " tot-net-in=" + std::to_string(client.net_input_bytes);
+    line += " tot-net-out=" + std::to_string(client.net_output_bytes);
+    line += "\n";
+    return line;
+}
+
+/**
+ * (P)SUBSCRIBE channel|pattern [...]: one confirmation per argument, carrying the
+ * connection's subscription count after it.
+ */
+Resp CommandExecutor::handle_subscribe(const Resp& cmd, Client& client, const bool pattern) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() < 2) return Resp::error("ERR invalid number of arguments for SUBSCRIBE");
+    if (client.in_multi) return Resp::error("ERR SUBSCRIBE isn't allowed inside MULTI");
+
+    const char* kind = pattern ? "psubscribe" : "subscribe";
+    Resp confirmation;
+    for (size_t i{1}; i < args.size(); ++i) {
+        const std::string& name = args[i].asString();
+        if (pattern) {
+            if (pubsub.psubscribe(client.id, client.protocol, name)) client.patterns.insert(name);
+        } else {
+            if (pubsub.subscribe(client.id, client.protocol, name)) client.channels.insert(name);
+        }
+        if (i > 1) client.addReply(confirmation.encode(client.protocol));
+        confirmation = Resp::push({Resp::bulkString(kind), Resp::bulkString(name),
+                                   Resp::integer(client.subscriptionCount())});
+    }
+    return confirmation;
+}
+
+/**
+ * (P)UNSUBSCRIBE [channel|pattern ...]: without arguments, drops every subscription of that kind.
+ */
+Resp CommandExecutor::handle_unsubscribe(const Resp& cmd, Client& client, const bool pattern) noexcept {
+    const RespVec& args = cmd.asArray();
+    const char* kind = pattern ? "punsubscribe" : "unsubscribe";
+    std::unordered_set<std::string>& subscribed = pattern ? client.patterns : client.channels;
+
+    std::vector<std::string> names;
+    if (args.size() > 1) {
+        for (size_t i{1}; i < args.size(); ++i) names.push_back(args[i].asString());
+    } else {
+        names.assign(subscribed.begin(), subscribed.end());
+    }
+    if (names.empty())
+        return Resp::push({Resp::bulkString(kind), Resp::nullBulkString(), Resp::integer(client.subscriptionCount())});
+
+    Resp confirmation;
+    for (size_t i{0}; i < names.size(); ++i) {
+        if (pattern) pubsub.punsubscribe(client.id, names[i]);
+        else pubsub.unsubscribe(client.id, names[i]);
+        subscribed.erase(names[i]);
+        if (i > 0) client.addReply(confirmation.encode(client.protocol));
+        confirmation = Resp::push({Resp::bulkString(kind), Resp::bulkString(names[i]),
+                                   Resp::integer(client.subscriptionCount())});
+    }
+    return confirmation;
+}
+
+void CommandExecutor::disconnect(const Client& client) noexcept {
+    if (!client.watched.empty()) {
+        std::unique_lock<std::mutex> storage_lock(storage_mutex);
+        drop_watches(client);
+    }
+    if (client.tracking) tracking.disable(client.id);
+    for (const auto& channel : client.channels) pubsub.unsubscribe(client.id, channel);
+    for (const auto& pattern : client.patterns) pubsub.punsubscribe(client.id, pattern);
+}
+
+/**
+ * Extracts the key arguments of a command using its key positions in the command table.
+ */
+std::vector<std::string> CommandExecutor::command_keys(const Resp& cmd, const Command& command) {
+    std::vector<std::string> keys;
+    const RespVec& args = cmd.asArray();
+    if (command.first_key <= 0) return keys;
+
+    const int argc = args.size();
+    const int last = command.last_key < 0 ? argc + command.last_key : command.last_key;
+    for (int i{command.first_key}; i <= last && i < argc; i += command.key_step)
+        keys.push_back(args[i].asString());
+    return keys;
+}
+
+// Remembers the keys a tracking client just read so it gets invalidated when they change
+void CommandExecutor::track_reads(const Resp& cmd, const Client& client) noexcept {
+    if (!client.tracking || client.tracking_bcast) return;
+    const Command* command = lookup(cmd);
+    if (!command || !(command->flags & CMD_READONLY)) return;
+    for (const auto& key : command_keys(cmd, *command)) {
+        for (const auto& [evicted, ids] : tracking.record_read(client.id, key))
+            send_invalidation(evicted, ids);
+    }
+}
+
+// Looks up a key a command reads or writes, updating its idle time and frequency
+// counter. Introspection uses storage.find() to leave them alone. Caller must hold storage_mutex.
+Keyspace::iterator CommandExecutor::find_key(const std::string& key) noexcept {
+    auto it = storage.find(key);
+    if (it != storage.end()) it->second.recordAccess();
+    return it;
+}
+
+void CommandExecutor::invalidate(const std::string& key) noexcept {
+    send_invalidation(key, tracking.invalidate(key));
+}
+
+// Tracking needs RESP3, so invalidations are encoded once as RESP3 for every receiver
+void CommandExecutor::send_invalidation(const std::string& key, const std::vector<uint64_t>& ids) noexcept {
+    if (ids.empty() || !push_handler) return;
+    Resp msg = Resp::push({Resp::bulkString("invalidate"), Resp::array({Resp::bulkString(key)})});
+    push_handler(ids, std::make_shared<const std::string>(msg.encode(3)));
+}
+
+void CommandExecutor::invalidate_all() noexcept {
+    std::vector<uint64_t> ids = tracking.invalidate_all();
+    if (ids.empty() || !push_handler) return;
+    Resp msg = Resp::push({Resp::bulkString("invalidate"), Resp::null()});
+    push_handler(ids, std::make_shared<const std::string>(msg.encode(3)));
+}
+
+// Adds a new key, keeping the cluster slot index in sync. Caller must hold storage_mutex.
+Keyspace::iterator CommandExecutor::insert_entry(const std::string& key, StorageEntry entry) {
+    if (!slot_keys.empty()) slot_keys[key_hash_slot(key)].insert(key);
+    return storage.emplace(key, std::move(entry)).first;
+}
+
+// Removes a key, destroying large values on the lazyfree thread when async. Caller must hold storage_mutex.
+void CommandExecutor::erase_entry(Keyspace::iterator it, const bool async) noexcept {
+    if (!slot_keys.empty()) slot_keys[key_hash_slot(it->first)].erase(it->first);
+    if (watch_counts.count(it->first)) tombstones[it->first] = deleted_version(it->second);
+    if (async) lazyfree.release(std::move(it->second));
+    storage.erase(it);
+}
+
+/**
+ * Locks storage_mutex, unless EXEC already holds it on this thread, in which case
+ * the returned lock owns nothing.
+ */
+std::unique_lock<std::mutex> CommandExecutor::lock_storage() noexcept {
+    if (in_exec) return std::unique_lock<std::mutex>();
+    return std::unique_lock<std::mutex>(storage_mutex);
+}
+
+// Version of a key for WATCH, 0 if it doesn't exist. Caller must hold storage_mutex.
+uint64_t CommandExecutor::key_version(const std::string& key) noexcept {
+    auto it = storage.find(key);
+    if (it == storage.end()) {
+        auto tombstone = tombstones.find(key);
+        return tombstone == tombstones.end() ? 0 : tombstone->second;
+    }
+    // Expiring changes the key, but removing the expired entry later doesn't change it again
+    if (it->second.isExpired()) return it->second.version | EXPIRED_VERSION;
+    return it->second.version;
+}
+
+// Version a watched key gets once entry is deleted. Caller must hold storage_mutex.
+uint64_t CommandExecutor::deleted_version(const StorageEntry& entry) noexcept {
+    // An expired entry already looks changed, removing it is no further change
+    if (entry.isExpired()) return entry.version | EXPIRED_VERSION;
+    return ++version_clock;
+}
+
+/**
+ * DEL/UNLINK key [key ...]: UNLINK only detaches the values and leaves freeing large
+ * ones to the lazyfree thread.
+ */
+Resp CommandExecutor::handle_del(const Resp& cmd, const bool async) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() < 2) return Resp::error("ERR invalid number of arguments for DEL");
+
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
+    int removed = 0;
+    for (size_t i{1}; i < args.size(); ++i) {
+        auto it = storage.find(args[i].asString());
+        if (it == storage.end()) continue;
+        if (!it->second.isExpired()) ++removed;
+        erase_entry(it, async);
+    }
+    return Resp::integer(removed);
+}
+
+/**
+ * FLUSHALL/FLUSHDB [ASYNC|SYNC]: there is a single database, so both drop every key.
+ */
+Resp CommandExecutor::handle_flushall(const Resp& cmd) noexcept {
+    const RespVec& args = cmd.asArray();
+    bool async = false;
+    if (args.size() > 2) return Resp::error("ERR syntax error");
+    if (args.size() == 2) {
+        std::string mode = args[1].asString();
+        make_upper(mode);
+        if (mode != "ASYNC" && mode != "SYNC") return Resp::error("ERR syntax error");
+        async = mode == "ASYNC";
+    }
+
+    Keyspace old;
+    {
+        std::unique_lock<std::mutex> storage_lock = lock_storage();
+        for (const auto& [key, count] : watch_counts) {
+            auto it = storage.find(key);
+            if (it != storage.end()) tombstones[key] = deleted_version(it->second);
+        }
+        old.swap(storage);
+        for (auto& keys : slot_keys) keys.clear();
+    }
+    invalidate_all();
+    if (async)
+        lazyfree.release(std::move(old));
+    // otherwise old is destroyed here, after storage_mutex was released
+    return Resp::simpleString("OK");
+}
+
+Resp CommandExecutor::handle_info(const Resp& cmd) noexcept {
+    std::string info = "# Memory\r\n";
+    info += "lazyfree_pending_objects:" + std::to_string(lazyfree.pending_objects()) + "\r\n";
+    info += "lazyfree_pending_bytes:" + std::to_string(lazyfree.pending_bytes()) + "\r\n";
+    info += "lazyfreed_objects:" + std::to_string(lazyfree.freed_objects()) + "\r\n";
+    sample_memory();
+    const size_t used = allocated_bytes();
+    const size_t rss = resident_bytes();
+    char ratio[32];
+    std::snprintf(ratio, sizeof(ratio), "%.2f", used ? static_cast<double>(rss) / used : 0.0);
+    info += "used_memory:" + std::to_string(used) + "\r\n";
+    info += "used_memory_rss:" + std::to_string(rss) + "\r\n";
+    info += "used_memory_peak:" + std::to_string(peak_memory) + "\r\n";
+    info += "mem_fragmentation_ratio:" + std::string(ratio) + "\r\n";
+    return Resp::bulkString(std::move(info));
+}
+
+void CommandExecutor::sample_memory() noexcept {
+    peak_memory = std::max(peak_memory, allocated_bytes());
+}
+
+/**
+ * OBJECT ENCODING|FREQ|IDLETIME key
+ * FREQ is the logarithmic access counter, IDLETIME the seconds since the last access;
+ * both are kept for every key since there is no eviction policy to choose between them.
+ */
+Resp CommandExecutor::handle_object(const Resp& cmd) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() != 3) return Resp::error("ERR invalid number of arguments for OBJECT");
+    std::string sub = args[1].asString();
+    make_upper(sub);
+    if (sub != "ENCODING" && sub != "FREQ" && sub != "IDLETIME")
+        return Resp::error("ERR unknown subcommand '" + args[1].asString() + "'");
+
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
+    auto it = storage.find(args[2].asString());
+    if (it == storage.end() || it->second.isExpired()) return Resp::nullBulkString();
+    const StorageEntry& entry = it->second;
+
+    if (sub == "ENCODING") return Resp::bulkString(entry.encodingName());
+    if (sub == "FREQ") return Resp::integer(entry.decayedFreq());
+    return Resp::integer(entry.idleSeconds());
+}
+
+/**
+ * MEMORY USAGE key [SAMPLES count]
+ * MEMORY STATS
+ *
+ * USAGE counts the key's dict node, bucket slot, key string and value, allocator
+ * overhead included. List elements are estimated from SAMPLES of them (default 5,
+ * 0 for all). STATS splits the allocated memory into overhead (startup, clients,
+ * hashtable buckets and links) and dataset, which holds the keys and values.
+ */
+Resp CommandExecutor::handle_memory(const Resp& cmd) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() < 2) return Resp::error("ERR invalid number of arguments for MEMORY");
+    std::string sub = args[1].asString();
+    make_upper(sub);
+
+    if (sub == "USAGE") {
+        if (args.size() != 3 && args.size() != 5) return Resp::error("ERR invalid number of arguments for MEMORY USAGE");
+        size_t samples = 5;
+        if (args.size() == 5) {
+            std::string option = args[3].asString();
+            make_upper(option);
+            auto count = parse_int(args[4]);
+            if (option != "SAMPLES" || !count || *count < 0) return Resp::error("ERR syntax error");
+            samples = *count;
+        }
+        std::unique_lock<std::mutex> storage_lock = lock_storage();
+        auto it = storage.find(args[2].asString());
+        if (it == storage.end() || it->second.isExpired()) return Resp::nullBulkString();
+        const size_t bytes = malloc_size(Keyspace::node_bytes()) + sizeof(void*) +
+                             string_heap_bytes(it->first) + it->second.estimatedBytes(samples);
+        return Resp::integer(bytes);
+    }
+    if (sub != "STATS") return Resp::error("ERR unknown subcommand '" + args[1].asString() + "'");
+
+    sample_memory();
+    const size_t allocated = allocated_bytes();
+    const size_t resident = resident_bytes();
+
+    size_t clients_normal = 0, clients_pubsub = 0;
+    if (clients) {
+        for (const auto& [fd, client] : clients->by_fd)
+            (client.isPubSub() ? clients_pubsub : clients_normal) += client.memoryUsage();
+    }
+
+    size_t keys, hashtable, slot_index = 0;
+    {
+        std::unique_lock<std::mutex> storage_lock = lock_storage();
+        keys = storage.size();
+        // The bucket array plus each node's chain link and malloc header; the key and the
+        // StorageEntry inside the node are dataset
+        const size_t node_overhead = malloc_size(Keyspace::node_bytes()) - Keyspace::node_bytes() + sizeof(void*);
+        hashtable = malloc_size(storage.bucket_count() * sizeof(void*)) + keys * node_overhead;
+        // Per key: a set node holding a copy of the key string
+        if (!slot_keys.empty()) slot_index = keys * malloc_size(sizeof(void*) * 2 + sizeof(std::string) + sizeof(size_t));
+    }
+
+    const size_t overhead = std::min(allocated, startup_memory + clients_normal + clients_pubsub + hashtable + slot_index);
+    const size_t dataset = allocated - overhead;
+    const size_t net = allocated > startup_memory ? allocated - startup_memory : 0;
+    auto percent = [](size_t part, size_t whole) { return whole ? 100.0 * part / whole : 0.0; };
+
+    return Resp::map({
+        Resp::bulkString("peak.allocated"), Resp::integer(peak_memory),
+        Resp::bulkString("total.allocated"), Resp::integer(allocated),
+        Resp::bulkString("startup.allocated"), Resp::integer(startup_memory),
+        Resp::bulkString("clients.normal"), Resp::integer(clients_normal),
+        Resp::bulkString("clients.pubsub"), Resp::integer(clients_pubsub),
+        Resp::bulkString("overhead.hashtable.main"), Resp::integer(hashtable),
+        Resp::bulkString("overhead.cluster.slot-index"), Resp::integer(slot_index),
+        Resp::bulkString("overhead.total"), Resp::integer(overhead),
+        Resp::bulkString("lazyfree.pending.bytes"), Resp::integer(lazyfree.pending_bytes()),
+        Resp::bulkString("keys.count"), Resp::integer(keys),
+        Resp::bulkString("keys.bytes-per-key"), Resp::integer(keys ? net / keys : 0),
+        Resp::bulkString("dataset.bytes"), Resp::integer(dataset),
+        Resp::bulkString("dataset.percentage"), Resp::doubleValue(percent(dataset, net)),
+        Resp::bulkString("peak.percentage"), Resp::doubleValue(percent(allocated, peak_memory)),
+        Resp::bulkString("allocator.allocated"), Resp::integer(allocated),
+        Resp::bulkString("allocator.resident"), Resp::integer(resident),
+        Resp::bulkString("allocator.fragmentation.ratio"), Resp::doubleValue(allocated ? static_cast<double>(resident) / allocated : 0),
+        Resp::bulkString("allocator.fragmentation.bytes"), Resp::integer(resident > allocated ? resident - allocated : 0),
+    });
+}
+
+/**
+ * DEBUG POPULATE count [prefix] [size]
+ * Creates keys prefix:0 .. prefix:count-1 (prefix defaults to "key") holding
+ * "value:<n>", padded with zero bytes or cut to size when given. Existing keys are
+ * left alone. The whole load runs under one storage lock, with the table sized up front.
+ */
+Resp CommandExecutor::handle_debug(const Resp& cmd) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() < 2) return Resp::error("ERR invalid number of arguments for DEBUG");
+    std::string sub = args[1].asString();
+    make_upper(sub);
+    if (sub != "POPULATE") return Resp::error("ERR unknown subcommand '" + args[1].asString() + "'");
+    if (args.size() < 3 || args.size() > 5) return Resp::error("ERR invalid number of arguments for DEBUG POPULATE");
+
+    auto count = parse_int(args[2]);
+    if (!count || *count < 0) return Resp::error("ERR count must be a non-negative integer");
+    std::optional<size_t> size;
+    if (args.size() == 5) {
+        auto parsed = parse_int(args[4]);
+        if (!parsed || *parsed < 0) return Resp::error("ERR size must be a non-negative integer");
+        size = *parsed;
+    }
+
+    std::string key = (args.size() >= 4 ? args[3].asString() : "key") + ":";
+    const size_t key_prefix = key.size();
+    std::string value;
+    char digits[24];
+
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
+    storage.reserve(storage.size() + *count);
+    for (int i{0}; i < *count; ++i) {
+        const size_t len = std::to_chars(digits, digits + sizeof(digits), i).ptr - digits;
+        key.resize(key_prefix);
+        key.append(digits, len);
+        if (storage.find(key) != storage.end()) continue;
+
+        value.assign("value:");
+        value.append(digits, len);
+        if (size) value.resize(*size, '\0');
+        StorageEntry entry{value, StorageType::String};
+        touch(entry);
+        insert_entry(key, std::move(entry));
+        invalidate(key);
+    }
+    return Resp::simpleString("OK");
+}
+
+/**
+ * CONFIG GET pattern | CONFIG SET parameter value
+ *
+ * Parameters:
+ *   timeout                     seconds a client may stay idle before it is closed, 0 = never
+ *   client-output-buffer-limit  "<class> <hard> <soft> <soft seconds> ..." for classes normal and pubsub
+ *   client-query-buffer-limit   max unparsed input per client
+ *   tracking-table-max-keys     max keys remembered for CLIENT TRACKING, 0 = no limit
+ * Sizes accept k/kb, m/mb and g/gb suffixes.
+ */
+Resp CommandExecutor::handle_config(const Resp& cmd) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() < 3) return Resp::error("ERR invalid number of arguments for CONFIG");
+    std::string sub = args[1].asString();
+    make_upper(sub);
+
+    auto format_limit = [](const char* name, const OutputBufferLimit& limit) {
+        return std::string(name) + " " + std::to_string(limit.hard_bytes) + " " + std::to_string(limit.soft_bytes) +
+               " " + std::to_string(limit.soft_seconds.count());
+    };
+
+    if (sub == "GET") {
+        if (args.size() != 3) return Resp::error("ERR invalid number of arguments for CONFIG GET");
+        const std::pair<const char*, std::string> params[] = {
+            {"timeout", std::to_string(client_cfg.idle_timeout.count())},
+            {"client-output-buffer-limit", format_limit("normal", client_cfg.normal_output) + " " +
+                                           format_limit("pubsub", client_cfg.pubsub_output)},
+            {"client-query-buffer-limit", std::to_string(client_cfg.query_buffer_limit)},
+            {"tracking-table-max-keys", std::to_string(tracking.max_keys())},
+        };
+        RespVec kv;
+        for (const auto& [name, value] : params) {
+            if (!glob_match(args[2].asString(), name)) continue;
+            kv.push_back(Resp::bulkString(name));
+            kv.push_back(Resp::bulkString(value));
+        }
+        return Resp::map(std::move(kv));
+    }
+    if (sub != "SET") return Resp::error("ERR unknown subcommand '" + args[1].asString() + "'");
+    if (args.size() != 4) return Resp::error("ERR invalid number of arguments for CONFIG SET");
+
+    std::string param = args[2].asString();
+    std::transform(param.begin(), param.end(), param.begin(), [](unsigned char c) { return std::tolower(c); });
+    const std::string& value = args[3].asString();
+    if (param == "timeout") {
+        auto seconds = parse_int(args[3]);
+        if (!seconds || *seconds < 0) return Resp::error("ERR Invalid argument '" + value + "' for CONFIG SET 'timeout'");
+        client_cfg.idle_timeout = std::chrono::seconds(*seconds);
+        return Resp::simpleString("OK");
+    }
+    if (param == "client-query-buffer-limit") {
+        auto bytes = parse_memory(value);
+        // A limit below a command header would make the connection unusable
+        if (!bytes || *bytes < 1024 * 1024) return Resp::error("ERR Invalid argument '" + value + "' for CONFIG SET 'client-query-buffer-limit'");
+        client_cfg.query_buffer_limit = *bytes;
+        return Resp::simpleString("OK");
+    }
+    if (param == "tracking-table-max-keys") {
+        // 0 disables the limit, a lower limit is applied on the next tracked read
+        size_t keys = 0;
+        auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), keys);
+        if (ec != std::errc() || end != value.data() + value.size())
+            return Resp::error("ERR Invalid argument '" + value + "' for CONFIG SET 'tracking-table-max-keys'");
+        tracking.set_max_keys(keys);
+        return Resp::simpleString("OK");
+    }
+    if (param == "client-output-buffer-limit") {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        while (start < value.size()) {
+            size_t end = value.find(' ', start);
+            if (end == std::string::npos) end = value.size();
+            if (end > start) fields.push_back(value.substr(start, end - start));
+            start = end + 1;
+        }
+        const Resp invalid = Resp::error("ERR Invalid argument '" + value + "' for CONFIG SET 'client-output-buffer-limit'");
+        if (fields.empty() || fields.size() % 4 != 0) return invalid;
+
+        // Validate every class before applying any, so a bad value changes nothing
+        ClientConfig updated = client_cfg;
+        for (size_t i{0}; i < fields.size(); i += 4) {
+            std::string cls = fields[i];
+            std::transform(cls.begin(), cls.end(), cls.begin(), [](unsigned char c) { return std::tolower(c); });
+            auto hard = parse_memory(fields[i + 1]);
+            auto soft = parse_memory(fields[i + 2]);
+            // Seconds take no unit suffix
+            const std::string& secs_str = fields[i + 3];
+            uint32_t secs = 0;
+            auto [secs_end, secs_ec] = std::from_chars(secs_str.data(), secs_str.data() + secs_str.size(), secs);
+            if (!hard || !soft || secs_ec != std::errc() || secs_end != secs_str.data() + secs_str.size()) return invalid;
+            OutputBufferLimit limit{*hard, *soft, std::chrono::seconds(secs)};
+            if (cls == "normal") updated.normal_output = limit;
+            else if (cls == "pubsub") updated.pubsub_output = limit;
+            else return invalid;
+        }
+        client_cfg = updated;
+        return Resp::simpleString("OK");
+    }
+    return Resp::error("ERR Unknown option or number of arguments for CONFIG SET - '" + args[2].asString() + "'");
+}
+
+/**
+ * SCAN cursor [MATCH pattern] [COUNT count] [TYPE type]
+ * Each call visits a bounded number of buckets: it stops once it has COUNT keys or has
+ * looked at 10 * COUNT buckets, so a sparse MATCH can return few or no keys with a
+ * non-zero cursor. Keys present for the whole iteration are returned at least once.
+ */
+Resp CommandExecutor::handle_scan(const Resp& cmd) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() < 2) return Resp::error("ERR invalid number of arguments for SCAN");
+
+    const std::string& cursor_str = args[1].asString();
+    size_t cursor = 0;
+    auto [end, ec] = std::from_chars(cursor_str.data(), cursor_str.data() + cursor_str.size(), cursor);
+    if (ec != std::errc() || end != cursor_str.data() + cursor_str.size())
+        return Resp::error("ERR invalid cursor");
+
+    std::optional<std::string> pattern;
+    std::optional<std::string> type;
+    size_t count = 10;
+    for (size_t i{2}; i < args.size(); i += 2) {
+        std::string option = args[i].asString();
+        make_upper(option);
+        if (i + 1 >= args.size()) return Resp::error("ERR syntax error");
+        if (option == "MATCH") {
+            pattern = args[i + 1].asString();
+        } else if (option == "COUNT") {
+            auto count_opt = parse_int(args[i + 1]);
+            if (!count_opt || *count_opt < 1) return Resp::error("ERR syntax error");
+            count = *count_opt;
+        } else if (option == "TYPE") {
+            type = args[i + 1].asString();
+        } else {
+            return Resp::error("ERR syntax error");
+        }
+    }
+    // "*" matches everything, skip calling the matcher
+    if (pattern && *pattern == "*") pattern.reset();
+
+    RespVec keys;
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
+    size_t buckets_left = count * 10;
+    auto collect = [&](const Keyspace::value_type& kv) {
+        const auto& [key, entry] = kv;
+        if (entry.isExpired()) return;
+        if (type && entry.getTypeName() != *type) return;
+        if (pattern && !glob_match(*pattern, key)) return;
+        keys.emplace_back(Resp::bulkString(key));
+    };
+    do {
+        cursor = storage.scan(cursor, collect, 0);
+    } while (cursor != 0 && keys.size() < count && --buckets_left > 0);
+
+    return Resp::array({Resp::bulkString(std::to_string(cursor)), Resp::array(std::move(keys))});
+}
+
+/**
+ * KEYS pattern: walks the whole keyspace in one pass under storage_mutex. Like in Redis
+ * it blocks the server for the duration, since every client is served by the event loop
+ * thread anyway; use SCAN on large keyspaces. A literal pattern is a single lookup.
+ */
+Resp CommandExecutor::handle_keys(const Resp& cmd) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() != 2) return Resp::error("ERR invalid number of arguments for KEYS");
+    const std::string& pattern = args[1].asString();
+    const bool match_all = pattern == "*";
+
+    RespVec keys;
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
+    if (glob_is_literal(pattern)) {
+        auto it = storage.find(pattern);
+        if (it != storage.end() && !it->second.isExpired())
+            keys.emplace_back(Resp::bulkString(pattern));
+        return Resp::array(std::move(keys));
+    }
+
+    for (const auto& [key, entry] : storage) {
+        if (!entry.isExpired() && (match_all || glob_match(pattern, key)))
+            keys.emplace_back(Resp::bulkString(key));
+    }
+    return Resp::array(std::move(keys));
+}
+
+Resp CommandExecutor::handle_publish(const Resp& cmd) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() != 3) return Resp::error("ERR invalid number of arguments for PUBLISH");
+    if (!push_handler) return Resp::integer(0);
+    return Resp::integer(pubsub.publish(args[1].asString(), args[2].asString(), push_handler));
+}
+
+void CommandExecutor::enable_cluster(std::vector<ClusterState::Node> nodes, int self) {
+    cluster.configure(std::move(nodes), self);
+    std::unique_lock<std::mutex> storage_lock(storage_mutex);
+    slot_keys.assign(CLUSTER_SLOTS, {});
+    for (const auto& [key, entry] : storage)
+        slot_keys[key_hash_slot(key)].insert(key);
+}
+
+std::optional<Resp> CommandExecutor::redirect(const Resp& cmd, Client& client) noexcept {
+    const bool asking = client.asking;
+    client.asking = false;
+    if (!cluster.enabled()) return std::nullopt;
+
+    const Command* command = lookup(cmd);
+    if (!command) return std::nullopt; // execute() reports unknown commands
+    std::vector<std::string> keys = command_keys(cmd, *command);
+    if (keys.empty()) return std::nullopt;
+
+    const int slot = key_hash_slot(keys[0]);
+    for (size_t i{1}; i < keys.size(); ++i) {
+        if (key_hash_slot(keys[i]) != slot)
+            return Resp::error("CROSSSLOT Keys in request don't hash to the same slot");
+    }
+
+    const ClusterState::SlotInfo info = cluster.slot(slot);
+    auto redirection = [&](const char* kind, int node_idx) {
+        const ClusterState::Node& node = cluster.node(node_idx);
+        return Resp::error(std::string(kind) + " " + std::to_string(slot) + " " + node.host + ":" + std::to_string(node.port));
+    };
+
+    if (info.owner != cluster.myself_index()) {
+        if (info.importing_from >= 0 && (asking || (command->flags & CMD_ASKING))) return std::nullopt;
+        if (info.owner < 0) return Resp::error("CLUSTERDOWN Hash slot not served");
+        return redirection("MOVED", info.owner);
+    }
+
+    if (info.migrating_to >= 0) {
+        // Keys already moved out live on the target now; send the client there for this one command
+        size_t missing = 0;
+        {
+            std::unique_lock<std::mutex> storage_lock = lock_storage();
+            for (const auto& key : keys) {
+                auto it = storage.find(key);
+                if (it == storage.end() || it->second.isExpired()) ++missing;
+            }
+        }
+        if (missing == keys.size()) return redirection("ASK", info.migrating_to);
+        if (missing > 0) return Resp::error("TRYAGAIN Multiple keys request during rehashing of slot");
+    }
+    return std::nullopt;
+}
+
+/**
+ * CLUSTER INFO | MYID | SLOTS | NODES | KEYSLOT key | COUNTKEYSINSLOT slot
+ *       | GETKEYSINSLOT slot count | SETSLOT slot IMPORTING|MIGRATING|NODE node-id | SETSLOT slot STABLE
+ */
+Resp CommandExecutor::handle_cluster(const Resp& cmd) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() < 2) return Resp::error("ERR invalid number of arguments for CLUSTER");
+    std::string sub = args[1].asString();
+    make_upper(sub);
+
+    if (sub == "KEYSLOT" && args.size() == 3) return Resp::integer(key_hash_slot(args[2].asString()));
+    if (!cluster.enabled()) return Resp::error("ERR This instance has cluster support disabled");
+
+    if (sub == "INFO") return Resp::bulkString(cluster.info_reply());
+    if (sub == "MYID") return Resp::bulkString(cluster.myself().id);
+    if (sub == "SLOTS") return cluster.slots_reply();
+    if (sub == "NODES") return Resp::bulkString(cluster.nodes_reply());
+
+    if (args.size() < 3) return Resp::error("ERR unknown subcommand or wrong number of arguments for '" + args[1].asString() + "'");
+    auto slot_opt = parse_int(args[2]);
+    if (!slot_opt || *slot_opt < 0 || *slot_opt >= CLUSTER_SLOTS) return Resp::error("ERR Invalid or out of range slot");
+    const int slot = *slot_opt;
+
+    if (sub == "COUNTKEYSINSLOT") {
+        std::unique_lock<std::mutex> storage_lock = lock_storage();
+        return Resp::integer(slot_keys[slot].size());
+    }
+    if (sub == "GETKEYSINSLOT" && args.size() == 4) {
+        auto count = parse_int(args[3]);
+        if (!count || *count < 0) return Resp::error("ERR Invalid number of keys");
+        RespVec keys;
+        std::unique_lock<std::mutex> storage_lock = lock_storage();
+        for (const auto& key : slot_keys[slot]) {
+            if (static_cast<int>(keys.size()) >= *count) break;
+            keys.emplace_back(Resp::bulkString(key));
+        }
+        return Resp::array(std::move(keys));
+    }
+    if (sub != "SETSLOT" || args.size() < 4) return Resp::error("ERR unknown subcommand or wrong number of arguments for '" + args[1].asString() + "'");
+
+    std::string action = args[3].asString();
+    make_upper(action);
+    if (action == "STABLE") {
+        cluster.set_stable(slot);
+        return Resp::simpleString("OK");
+    }
+    if (args.size() != 5) return Resp::error("ERR syntax error");
+    auto node_idx = cluster.find_node(args[4].asString());
+    if (!node_idx) return Resp::error("ERR I don't know about node " + args[4].asString());
+
+    const int me = cluster.myself_index();
+    const int owner = cluster.slot(slot).owner;
+    if (action == "MIGRATING") {
+        if (owner != me) return Resp::error("ERR I'm not the owner of hash slot " + std::to_string(slot));
+        if (*node_idx == me) return Resp::error("ERR I can't migrate to myself");
+        cluster.set_migrating(slot, *node_idx);
+    } else if (action == "IMPORTING") {
+        if (owner == me) return Resp::error("ERR I'm already the owner of hash slot " + std::to_string(slot));
+        cluster.set_importing(slot, *node_idx);
+    } else if (action == "NODE") {
+        if (owner == me && *node_idx != me) {
+            std::unique_lock<std::mutex> storage_lock = lock_storage();
+            if (!slot_keys[slot].empty())
+                return Resp::error("ERR Can't assign hashslot " + std::to_string(slot) + " to a different node while I still hold keys for this hash slot.");
+        }
+        cluster.set_owner(slot, *node_idx); // also ends any migration of the slot
+    } else {
+        return Resp::error("ERR syntax error");
+    }
+    return Resp::simpleString("OK");
+}
+
+Resp CommandExecutor::handle_dump(const Resp& cmd) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() != 2) return Resp::error("ERR invalid number of arguments for DUMP");
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
+    auto it = find_key(args[1].asString());
+    if (it == storage.end() || it->second.isExpired()) return Resp::nullBulkString();
+    return Resp::bulkString(dump_value(it->second));
+}
+
+/**
+ * RESTORE key ttl serialized-value [REPLACE], ttl in milliseconds with 0 for no expiry.
+ * RESTORE-ASKING is the same command sent by MIGRATE to a node importing the slot.
+ */
+Resp CommandExecutor::handle_restore(const Resp& cmd) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() < 4 || args.size() > 5) return Resp::error("ERR invalid number of arguments for RESTORE");
+    const std::string& key = args[1].asString();
+    // MIGRATE sends the remaining TTL in milliseconds, which overflows an int after ~24.8 days
+    const std::string& ttl_str = args[2].asString();
+    int64_t ttl = 0;
+    auto [ttl_end, ttl_ec] = std::from_chars(ttl_str.data(), ttl_str.data() + ttl_str.size(), ttl);
+    if (ttl_ec != std::errc() || ttl_end != ttl_str.data() + ttl_str.size() || ttl < 0)
+        return Resp::error("ERR Invalid TTL value, must be >= 0");
+    // steady_clock counts nanoseconds, so the deadline has to fit in its duration
+    const auto now = std::chrono::steady_clock::now();
+    const auto max_ttl = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::duration::max() - now.time_since_epoch());
+    if (ttl > max_ttl.count()) return Resp::error("ERR invalid expire time in 'restore' command");
+    bool replace = false;
+    if (args.size() == 5) {
+        std::string option = args[4].asString();
+        make_upper(option);
+        if (option != "REPLACE") return Resp::error("ERR syntax error");
+        replace = true;
+    }
+    auto entry = restore_value(args[3].asString());
+    if (!entry) return Resp::error("ERR DUMP payload version or checksum are wrong");
+    if (ttl > 0) entry->expiry = now + std::chrono::milliseconds(ttl);
+
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
+    touch(*entry);
+    auto it = storage.find(key);
+    if (it == storage.end()) {
+        insert_entry(key, std::move(*entry));
+    } else {
+        if (!replace && !it->second.isExpired()) return Resp::error("BUSYKEY Target key name already exists.");
+        lazyfree.release(std::move(it->second));
+        it->second = std::move(*entry);
+    }
+    return Resp::simpleString("OK");
+}
+
+/**
+ * MIGRATE host port key|"" destination-db timeout [COPY] [REPLACE] [KEYS key [key ...]]
+ * Sends every key as RESTORE-ASKING in one pipelined batch and, unless COPY, deletes the
+ * keys the target accepted. Like in Redis it blocks the calling connection until the
+ * target answers or timeout (ms, 1000 if not positive) expires. The values are
+ * snapshotted first and storage_mutex is not held during the transfer; a key written in
+ * the meantime (by a blocking command's thread) is kept rather than deleted.
+ */
+Resp CommandExecutor::handle_migrate(const Resp& cmd) noexcept {
+    const RespVec& args = cmd.asArray();
+    if (args.size() < 6) return Resp::error("ERR invalid number of arguments for MIGRATE");
+    const std::string& host = args[1].asString();
+    auto port = parse_int(args[2]);
+    auto db = parse_int(args[4]);
+    auto timeout = parse_int(args[5]);
+    if (!port || !timeout) return Resp::error("ERR value is not an integer or out of range");
+    if (!db || *db != 0) return Resp::error("ERR only database 0 is supported");
+    // A zero timeval disables SO_RCVTIMEO, so a stalled target would block forever
+    if (*timeout <= 0) timeout = 1000;
+    // This node couldn't answer: its event loop is the one waiting for the reply
+    if (is_self(host, *port)) return Resp::error("ERR Target instance is this instance");
+
+    bool copy = false, replace = false;
+    std::vector<std::string> keys;
+    if (!args[3].asString().empty()) keys.push_back(args[3].asString());
+    for (size_t i{6}; i < args.size(); ++i) {
+        std::string option = args[i].asString();
+        make_upper(option);
+        if (option == "COPY") {
+            copy = true;
+        } else if (option == "REPLACE") {
+            replace = true;
+        } else if (option == "KEYS" && args[3].asString().empty()) {
+            for (++i; i < args.size(); ++i) keys.push_back(args[i].asString());
+        } else {
+            return Resp::error("ERR syntax error");
+        }
+    }
+
+    std::unique_lock<std::mutex> storage_lock = lock_storage();
+    std::string batch;
+    std::vector<std::string> sent;
+    std::vector<uint64_t> sent_versions; // deletion is skipped for keys written since
+    const auto now = std::chrono::steady_clock::now();
+    for (const auto& key : keys) {
+        auto it = storage.find(key);
+        if (it == storage.end() || it->second.isExpired()) continue;
+        long long ttl = 0;
+        if (it->second.expiry)
+            ttl = std::max<long long>(1, std::chrono::duration_cast<std::chrono::milliseconds>(*it->second.expiry - now).count());
+        RespVec restore{Resp::bulkString("RESTORE-ASKING"), Resp::bulkString(key),
+                        Resp::bulkString(std::to_string(ttl)), Resp::bulkString(dump_value(it->second))};
+        if (replace) restore.push_back(Resp::bulkString("REPLACE"));
+        batch += Resp::array(std::move(restore)).encode();
+        sent.push_back(key);
+        sent_versions.push_back(it->second.version);
+    }
+    if (sent.empty()) return Resp::simpleString("NOKEY");
+
+    // Inside EXEC the lock belongs to the whole batch and can't be released
+    if (storage_lock.owns_lock()) storage_lock.unlock();
+    auto replies = send_batch(host, *port, *timeout, batch, sent.size());
+    if (!replies) return Resp::error("IOERR error or timeout reading to target instance");
+    storage_lock = lock_storage();
+
+    std::optional<std::string> target_error;
+    for (size_t i{0}; i < sent.size(); ++i) {
+        if ((*replies)[i].type == RespType::Error) {
+            if (!target_error) target_error = (*replies)[i].asString();
+            continue;
+        }
+        if (copy) continue;
+        auto it = storage.find(sent[i]);
+        if (it != storage.end() && it->second.version == sent_versions[i]) erase_entry(it, true);
+    }
+    if (!copy) {
+        storage_lock = std::unique_lock<std::mutex>(); // release before invalidating, like execute() does
+        for (const auto& key : sent) invalidate(key);
+    }
+    if (target_error) return Resp::error("ERR Target instance replied with error: " + *target_error);
+    return Resp::simpleString("OK");
+}
+
+// True if host:port is this server's own listening address
+bool CommandExecutor::is_self(const std::string& host, int port) const noexcept {
+    if (port != listen_port) return false;
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addrs = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &addrs) != 0) return false;
+    const in_addr_t target = reinterpret_cast<sockaddr_in*>(addrs->ai_addr)->sin_addr.s_addr;
+    freeaddrinfo(addrs);
+    // The server listens on INADDR_ANY: loopback, the wildcard and every interface address reach it
+    if ((ntohl(target) >> 24) == 127 || target == htonl(INADDR_ANY)) return true;
+
+    ifaddrs* interfaces = nullptr;
+    if (getifaddrs(&interfaces) != 0) return false;
+    bool local = false;
+    for (ifaddrs* ifa = interfaces; ifa && !local; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr && ifa->ifa_addr->sa_family == AF_INET)
+            local = reinterpret_cast<sockaddr_in*>(ifa->ifa_addr)->sin_addr.s_addr == target;
+    }
+    freeifaddrs(interfaces);
+    return local;
+}
+
 std::optional<int> CommandExecutor::parse_int(const Resp& arg) noexcept {
     try {
         int i = std::stoi(arg.asString());
@@ -269,6 +1564,32 @@ std::optional<int> CommandExecutor::parse_int(const Resp& arg) noexcept {
     }
 }
 
+/**
+ * Parses a size such as 512, 64kb or 1gb. k, m and g are powers of 1000, kb, mb and gb
+ * powers of 1024, case insensitive.
+ */
+std::optional<size_t> CommandExecutor::parse_memory(std::string str) noexcept {
+    std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return std::tolower(c); });
+    size_t multiplier = 1;
+    const std::pair<const char*, size_t> units[] = {
+        {"kb", 1024}, {"mb", 1024 * 1024}, {"gb", 1024 * 1024 * 1024},
+        {"k", 1000}, {"m", 1000 * 1000}, {"g", 1000 * 1000 * 1000},
+    };
+    for (const auto& [suffix, bytes] : units) {
+        const size_t len = std::strlen(suffix);
+        if (str.size() > len && str.compare(str.size() - len, len, suffix) == 0) {
+            str.resize(str.size() - len);
+            multiplier = bytes;
+            break;
+        }
+    }
+    size_t value = 0;
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc() || end != str.data() + str.size() || str.empty()) return std::nullopt;
+    if (value > std::numeric_limits<size_t>::max() / multiplier) return std::nullopt;
+    return value * multiplier;
+}
+
 /**
  * Converts a negative index to it's corresponding positive index.
  * If the index is already positive, returns with no change.
@@ -287,4 +1608,83 @@ void CommandExecutor::push_string(StringList& list, std::string str, const bool
     else
         list.push_front(std::move(str));
     
-}
\ No newline at end of file
+}
+
+// DUMP/RESTORE payload: the value itself in RESP, a bulk string or an array of bulk strings
+std::string CommandExecutor::dump_value(const StorageEntry& entry) {
+    if (entry.type == StorageType::String) return Resp::bulkString(std::get<std::string>(entry.value)).encode();
+    RespVec elements;
+    for (const auto& el : std::get<StringList>(entry.value))
+        elements.emplace_back(Resp::bulkString(el));
+    return Resp::array(std::move(elements)).encode();
+}
+
+std::optional<StorageEntry> CommandExecutor::restore_value(const std::string& payload) {
+    std::vector<u8> bytes(payload.begin(), payload.end());
+    RespParser parser(bytes);
+    auto value = parser.parse();
+    if (!value || !parser.bufferEmpty()) return std::nullopt;
+
+    if (value->type == RespType::BulkString) return StorageEntry{value->asString(), StorageType::String};
+    if (value->type != RespType::Array) return std::nullopt;
+    StringList list;
+    for (const auto& el : value->asArray()) {
+        if (el.type != RespType::BulkString) return std::nullopt;
+        list.push_back(el.asString());
+    }
+    return StorageEntry{std::move(list), StorageType::List};
+}
+
+/**
+ * Connects to host:port, writes batch and reads back the given number of replies, each
+ * step bounded by timeout_ms. Returns nullopt on any I/O error or timeout.
+ */
+std::optional<RespVec> CommandExecutor::send_batch(const std::string& host, int port, int timeout_ms,
+                                                   const std::string& batch, size_t replies) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addrs = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addrs) != 0) return std::nullopt;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        freeaddrinfo(addrs);
+        return std::nullopt;
+    }
+    timeval tv{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    const bool connected = connect(fd, addrs->ai_addr, addrs->ai_addrlen) == 0;
+    freeaddrinfo(addrs);
+
+    std::optional<RespVec> result;
+    size_t sent = 0;
+    while (connected && sent < batch.size()) {
+        ssize_t n = send(fd, batch.data() + sent, batch.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) break;
+        sent += n;
+    }
+    std::vector<u8> buffer;
+    while (connected && sent == batch.size()) {
+        u8 chunk[4096];
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) break;
+        buffer.insert(buffer.end(), chunk, chunk + n);
+
+        // Replies may arrive split across reads, so parse from the start until one is incomplete
+        RespParser parser(buffer);
+        RespVec parsed;
+        while (parsed.size() < replies) {
+            auto reply = parser.parse();
+            if (!reply) break;
+            parsed.push_back(std::move(*reply));
+        }
+        if (parsed.size() == replies) {
+            result = std::move(parsed);
+            break;
+        }
+    }
+    close(fd);
+    return result;
+}
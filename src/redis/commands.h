@@ -3,10 +3,17 @@
 
 #include "../resp/resp.h"
 #include "storage.h"
+#include "client.h"
+#include "tracking.h"
+#include "lazyfree.h"
+#include "pubsub.h"
+#include "cluster.h"
+#include "memory.h"
 
 #include <string>
 #include <unordered_map>
 #include <functional>
+#include <unordered_set>
 
 #include <mutex>
 #include <condition_variable>
@@ -14,18 +21,109 @@
 class CommandExecutor {
 public:
     using CommandFunc = std::function<Resp(const Resp& cmd)>;
+    // Queues an encoded out-of-band message (tracking invalidation, published message) on
+    // other connections; may be called from any thread
+    using PushFunc = PubSub::DeliverFunc;
+    enum CommandFlags {
+        CMD_WRITE = 1 << 0,
+        CMD_READONLY = 1 << 1,
+        CMD_ASKING = 1 << 2, // accepted on an importing slot without a preceding ASKING
+    };
+    struct Command {
+        CommandFunc func;
+        int arity; // exact argc (including the name) if positive, minimum argc if negative
+        int flags = 0;
+        // Key arguments are args[first_key], args[first_key + key_step]... up to args[last_key].
+        // first_key is 0 for commands without keys, a negative last_key counts from the end.
+        int first_key = 0;
+        int last_key = 0;
+        int key_step = 1;
+    };
     CommandExecutor();
-    Resp execute(const Resp& cmd) const noexcept;
+    Resp execute(const Resp& cmd) noexcept;
+    // Connection-aware entry point: handles MULTI/EXEC/DISCARD/WATCH, HELLO, CLIENT,
+    // (UN)SUBSCRIBE and queueing. Commands that reply more than once add the extra replies
+    // to client directly and return the last one.
+    Resp execute(const Resp& cmd, Client& client) noexcept;
+    void set_push_handler(PushFunc handler) { push_handler = std::move(handler); }
+    // The event loop's connections, for CLIENT LIST and CLIENT KILL
+    void set_client_table(ClientTable* table) { clients = table; }
+    // The port this server accepts clients on, so MIGRATE can refuse to target itself
+    void set_listen_port(int port) { listen_port = port; }
+    const ClientConfig& client_config() const { return client_cfg; }
+    // Updates the peak memory figure, called periodically by the event loop
+    void sample_memory() noexcept;
+    // Drops server-side state held for a connection that is going away
+    void disconnect(const Client& client) noexcept;
+    // Switches to cluster mode; self is this node's index in nodes
+    void enable_cluster(std::vector<ClusterState::Node> nodes, int self);
+    // In cluster mode, the MOVED/ASK/CROSSSLOT error for a command this node must not run.
+    // Consumes the client's ASKING flag.
+    std::optional<Resp> redirect(const Resp& cmd, Client& client) noexcept;
     static void make_upper(std::string& str) {
         std::transform(str.begin(), str.end(), str.begin(),
             [](unsigned char c){ return std::toupper(c); }); // Use a lambda for safety/clarity
     }
 private:
-    std::unordered_map<std::string, CommandFunc> commandMap;
-    std::unordered_map<std::string, StorageEntry> storage;
+    std::unordered_map<std::string, Command> commandMap;
+    Keyspace storage;
+    uint64_t version_clock = 0; // source of StorageEntry::version, protected by storage_mutex
+    // Set in the version WATCH sees for an expired key that is still stored
+    static constexpr uint64_t EXPIRED_VERSION = uint64_t{1} << 63;
+    // Watched keys -> number of watching clients, and the version a watched key had when it
+    // was deleted, so WATCH notices a key that was created and deleted again. Protected by storage_mutex.
+    std::unordered_map<std::string, size_t> watch_counts;
+    std::unordered_map<std::string, uint64_t> tombstones;
     std::unordered_map<std::string, std::shared_ptr<std::condition_variable>> key_cvs;
     std::mutex key_cvs_mutex;  // protects the above map
     std::mutex storage_mutex; // protects storage
+    TrackingTable tracking;
+    LazyFree lazyfree;
+    PubSub pubsub;
+    PushFunc push_handler;
+    ClusterState cluster;
+    ClientTable* clients = nullptr;
+    int listen_port = 0;
+    ClientConfig client_cfg; // only touched on the event loop thread
+    size_t startup_memory = 0; // allocated bytes once the executor was constructed
+    size_t peak_memory = 0;
+    // Keys of each hash slot, cluster mode only, protected by storage_mutex
+    std::vector<std::unordered_set<std::string>> slot_keys;
+
+    // Set while EXEC runs its queue on this thread with storage_mutex already held
+    static thread_local bool in_exec;
+
+    std::unique_lock<std::mutex> lock_storage() noexcept;
+    void touch(StorageEntry& entry) noexcept { entry.version = ++version_clock; }
+    uint64_t key_version(const std::string& key) noexcept;
+    uint64_t deleted_version(const StorageEntry& entry) noexcept;
+    void unwatch_all(Client& client) noexcept;
+    void drop_watches(const Client& client) noexcept;
+
+    const Command* lookup(const Resp& cmd) const noexcept;
+    static std::vector<std::string> command_keys(const Resp& cmd, const Command& command);
+    void track_reads(const Resp& cmd, const Client& client) noexcept;
+    Keyspace::iterator find_key(const std::string& key) noexcept;
+    void invalidate(const std::string& key) noexcept;
+    void send_invalidation(const std::string& key, const std::vector<uint64_t>& ids) noexcept;
+    void invalidate_all() noexcept;
+    Keyspace::iterator insert_entry(const std::string& key, StorageEntry entry);
+    void erase_entry(Keyspace::iterator it, const bool async) noexcept;
+
+    static const std::unordered_set<std::string> CONNECTION_COMMANDS;
+    Resp execute_connection(const std::string& cmd_str, const Resp& cmd, Client& client) noexcept;
+
+    std::optional<Resp> validate(const Resp& cmd) const noexcept;
+    Resp handle_hello(const Resp& cmd, Client& client) noexcept;
+    Resp handle_client(const Resp& cmd, Client& client) noexcept;
+    Resp handle_client_kill(const Resp& cmd, Client& client) noexcept;
+    Resp handle_config(const Resp& cmd) noexcept;
+    Resp handle_subscribe(const Resp& cmd, Client& client, const bool pattern) noexcept;
+    Resp handle_unsubscribe(const Resp& cmd, Client& client, const bool pattern) noexcept;
+    Resp handle_multi(Client& client) noexcept;
+    Resp handle_exec(Client& client) noexcept;
+    Resp handle_discard(Client& client) noexcept;
+    Resp handle_watch(const Resp& cmd, Client& client) noexcept;
 
     Resp handle_ping(const Resp& cmd) noexcept;
     Resp handle_echo(const Resp& cmd) noexcept;
@@ -37,10 +135,30 @@ private:
     Resp handle_lpop(const Resp& cmd) noexcept;
     Resp handle_blpop(const Resp& cmd) noexcept;
     Resp handle_type(const Resp& cmd) noexcept;
+    Resp handle_del(const Resp& cmd, const bool async) noexcept;
+    Resp handle_flushall(const Resp& cmd) noexcept;
+    Resp handle_info(const Resp& cmd) noexcept;
+    Resp handle_object(const Resp& cmd) noexcept;
+    Resp handle_memory(const Resp& cmd) noexcept;
+    Resp handle_debug(const Resp& cmd) noexcept;
+    Resp handle_scan(const Resp& cmd) noexcept;
+    Resp handle_keys(const Resp& cmd) noexcept;
+    Resp handle_publish(const Resp& cmd) noexcept;
+    Resp handle_cluster(const Resp& cmd) noexcept;
+    Resp handle_dump(const Resp& cmd) noexcept;
+    Resp handle_restore(const Resp& cmd) noexcept;
+    Resp handle_migrate(const Resp& cmd) noexcept;
 
+    bool is_self(const std::string& host, int port) const noexcept;
     static std::optional<int> parse_int(const Resp& arg) noexcept;
+    static std::optional<size_t> parse_memory(std::string str) noexcept;
+    static std::string client_info(const Client& client, Client::Clock::time_point now);
     static int normalize_index(int i, const int size) noexcept;
     static void push_string(StringList& list, std::string str, const bool rPush);
+    static std::string dump_value(const StorageEntry& entry);
+    static std::optional<StorageEntry> restore_value(const std::string& payload);
+    static std::optional<RespVec> send_batch(const std::string& host, int port, int timeout_ms,
+                                             const std::string& batch, size_t replies);
 
 };
 
@@ -0,0 +1,249 @@
+#ifndef DICT_H
+#define DICT_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Chained hash table keyed by std::string with a power-of-two bucket count.
+ *
+ * It mirrors the parts of std::unordered_map the executor uses, and exists for scan():
+ * with a power-of-two table, a cursor that walks bucket indices in reverse-binary order
+ * visits every element present for the whole scan exactly once or more, even if the
+ * table grows or shrinks between calls. std::unordered_map uses prime bucket counts,
+ * so it can't offer that guarantee.
+ *
+ * Like std::unordered_map, nodes never move: references to elements stay valid until the
+ * element is erased, while iterators are invalidated by inserts and erases that rehash.
+ */
+template <typename V>
+class Dict {
+public:
+    using value_type = std::pair<const std::string, V>;
+
+private:
+    struct Node {
+        value_type kv;
+        Node* next = nullptr;
+    };
+
+    static constexpr size_t INITIAL_SIZE = 4;
+
+    std::vector<Node*> table;
+    size_t count = 0;
+
+    size_t mask() const noexcept { return table.size() - 1; }
+    static size_t hash(const std::string& key) noexcept { return std::hash<std::string>{}(key); }
+
+    // Moves every node into a table of new_size buckets (a power of two)
+    void rehash(size_t new_size) {
+        std::vector<Node*> new_table(new_size, nullptr);
+        for (Node* node : table) {
+            while (node) {
+                Node* next = node->next;
+                size_t idx = hash(node->kv.first) & (new_size - 1);
+                node->next = new_table[idx];
+                new_table[idx] = node;
+                node = next;
+            }
+        }
+        table.swap(new_table);
+    }
+
+    void grow_if_needed() {
+        if (table.empty()) table.assign(INITIAL_SIZE, nullptr);
+        else if (count >= table.size()) rehash(table.size() * 2);
+    }
+
+    void shrink_if_needed() {
+        // Keep load above ~10% so scans don't wade through empty buckets
+        size_t size = table.size();
+        while (size > INITIAL_SIZE && count * 10 < size) size /= 2;
+        if (size != table.size()) rehash(size);
+    }
+
+    // Reverses the bits of v, used to increment cursors from the high bit down
+    static size_t rev(size_t v) noexcept {
+        size_t s = sizeof(v) * 8;
+        size_t mask = ~size_t{0};
+        while ((s >>= 1) > 0) {
+            mask ^= (mask << s);
+            v = ((v >> s) & mask) | ((v << s) & ~mask);
+        }
+        return v;
+    }
+
+    template <bool Const>
+    class Iter {
+        using DictPtr = std::conditional_t<Const, const Dict*, Dict*>;
+        DictPtr dict = nullptr;
+        size_t bucket = 0;
+        Node* node = nullptr;
+        friend class Dict;
+        friend class Iter<!Const>;
+
+        Iter(DictPtr d, size_t b, Node* n) : dict{d}, bucket{b}, node{n} {}
+        void skip_empty() {
+            while (!node && ++bucket < dict->table.size()) node = dict->table[bucket];
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Dict::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+
+        Iter() = default;
+        operator Iter<true>() const { return Iter<true>(dict, bucket, node); }
+
+        reference operator*() const { return node->kv; }
+        pointer operator->() const { return &node->kv; }
+        Iter& operator++() {
+            node = node->next;
+            if (!node) skip_empty();
+            return *this;
+        }
+        Iter operator++(int) { Iter old = *this; ++*this; return old; }
+        bool operator==(const Iter& other) const { return node == other.node; }
+        bool operator!=(const Iter& other) const { return node != other.node; }
+    };
+
+public:
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    Dict() = default;
+    ~Dict() { clear(); }
+    Dict(const Dict&) = delete;
+    Dict& operator=(const Dict&) = delete;
+    Dict(Dict&& other) noexcept : table{std::move(other.table)}, count{other.count} {
+        other.table.clear();
+        other.count = 0;
+    }
+    Dict& operator=(Dict&& other) noexcept {
+        if (this != &other) {
+            clear();
+            swap(other);
+        }
+        return *this;
+    }
+
+    void swap(Dict& other) noexcept {
+        table.swap(other.table);
+        std::swap(count, other.count);
+    }
+
+    size_t size() const noexcept { return count; }
+    bool empty() const noexcept { return count == 0; }
+    size_t bucket_count() const noexcept { return table.size(); }
+    // Bytes of one element's node, not counting what the key and value allocate
+    static constexpr size_t node_bytes() noexcept { return sizeof(Node); }
+
+    // Sizes the table for n elements up front, so a bulk insert doesn't rehash on the way
+    void reserve(size_t n) {
+        size_t size = table.empty() ? INITIAL_SIZE : table.size();
+        while (size <= n) size *= 2;
+        if (size != table.size()) rehash(size);
+    }
+
+    void clear() noexcept {
+        for (Node* node : table) {
+            while (node) {
+                Node* next = node->next;
+                delete node;
+                node = next;
+            }
+        }
+        table.clear();
+        count = 0;
+    }
+
+    iterator begin() noexcept {
+        if (table.empty()) return end();
+        iterator it(this, 0, table[0]);
+        if (!it.node) it.skip_empty();
+        return it;
+    }
+    iterator end() noexcept { return iterator(this, table.size(), nullptr); }
+    const_iterator begin() const noexcept {
+        if (table.empty()) return end();
+        const_iterator it(this, 0, table[0]);
+        if (!it.node) it.skip_empty();
+        return it;
+    }
+    const_iterator end() const noexcept { return const_iterator(this, table.size(), nullptr); }
+
+    iterator find(const std::string& key) noexcept {
+        if (table.empty()) return end();
+        size_t idx = hash(key) & mask();
+        for (Node* node = table[idx]; node; node = node->next) {
+            if (node->kv.first == key) return iterator(this, idx, node);
+        }
+        return end();
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(const std::string& key, Args&&... args) {
+        auto it = find(key);
+        if (it != end()) return {it, false};
+        grow_if_needed();
+        size_t idx = hash(key) & mask();
+        Node* node = new Node{value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                                         std::forward_as_tuple(std::forward<Args>(args)...)),
+                              table[idx]};
+        table[idx] = node;
+        ++count;
+        return {iterator(this, idx, node), true};
+    }
+
+    V& operator[](const std::string& key) { return emplace(key).first->second; }
+
+    void erase(iterator it) {
+        Node** link = &table[it.bucket];
+        while (*link != it.node) link = &(*link)->next;
+        *link = it.node->next;
+        delete it.node;
+        --count;
+        shrink_if_needed();
+    }
+
+    size_t erase(const std::string& key) {
+        auto it = find(key);
+        if (it == end()) return 0;
+        erase(it);
+        return 1;
+    }
+
+    /**
+     * Visits one bucket at cursor (plus further buckets while they are empty, at most
+     * max_empty of them) and calls fn on every element in the visited buckets. Returns the
+     * next cursor, 0 once the whole table has been covered. Start with cursor 0.
+     */
+    template <typename Fn>
+    size_t scan(size_t cursor, Fn&& fn, size_t max_empty = 10) const {
+        if (table.empty()) return 0;
+        const size_t m = mask();
+        while (true) {
+            Node* node = table[cursor & m];
+            const bool had_elements = node != nullptr;
+            for (; node; node = node->next) fn(node->kv);
+
+            // Increment the reversed cursor: set the unmasked bits so the carry propagates past them
+            cursor |= ~m;
+            cursor = rev(cursor);
+            ++cursor;
+            cursor = rev(cursor);
+
+            if (cursor == 0 || had_elements || max_empty-- == 0) return cursor;
+        }
+    }
+};
+
+#endif
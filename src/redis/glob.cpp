@@ -0,0 +1,74 @@
+#include "glob.h"
+
+// Matches str[0] against the class starting after '[' at pattern[p], advancing p past ']'
+static bool match_class(std::string_view pattern, size_t& p, char c) noexcept {
+    bool negate = p < pattern.size() && pattern[p] == '^';
+    if (negate) ++p;
+
+    bool matched = false;
+    while (p < pattern.size() && pattern[p] != ']') {
+        if (pattern[p] == '\\' && p + 1 < pattern.size()) {
+            ++p;
+            if (pattern[p] == c) matched = true;
+        } else if (p + 2 < pattern.size() && pattern[p + 1] == '-' && pattern[p + 2] != ']') {
+            char lo = pattern[p], hi = pattern[p + 2];
+            if (lo > hi) std::swap(lo, hi);
+            if (c >= lo && c <= hi) matched = true;
+            p += 2;
+        } else if (pattern[p] == c) {
+            matched = true;
+        }
+        ++p;
+    }
+    if (p < pattern.size()) ++p; // skip ']'
+    return matched != negate;
+}
+
+bool glob_match(std::string_view pattern, std::string_view str) noexcept {
+    size_t p = 0, s = 0;
+    // Where to resume after the last '*': pattern just past it, and the next str position it should absorb
+    size_t star_p = std::string_view::npos, star_s = 0;
+
+    while (s < str.size()) {
+        if (p < pattern.size()) {
+            char pc = pattern[p];
+            if (pc == '*') {
+                while (p < pattern.size() && pattern[p] == '*') ++p;
+                if (p == pattern.size()) return true; // trailing '*' matches the rest
+                star_p = p;
+                star_s = s;
+                continue;
+            }
+            if (pc == '?') {
+                ++p;
+                ++s;
+                continue;
+            }
+            if (pc == '[') {
+                size_t class_p = p + 1;
+                if (match_class(pattern, class_p, str[s])) {
+                    p = class_p;
+                    ++s;
+                    continue;
+                }
+            } else {
+                if (pc == '\\' && p + 1 < pattern.size()) pc = pattern[++p];
+                if (pc == str[s]) {
+                    ++p;
+                    ++s;
+                    continue;
+                }
+            }
+        }
+        // Mismatch: let the last '*' swallow one more character, or fail if there was none
+        if (star_p == std::string_view::npos) return false;
+        p = star_p;
+        s = ++star_s;
+    }
+    while (p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+bool glob_is_literal(std::string_view pattern) noexcept {
+    return pattern.find_first_of("*?[\\") == std::string_view::npos;
+}
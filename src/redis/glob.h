@@ -0,0 +1,13 @@
+#ifndef GLOB_H
+#define GLOB_H
+
+#include <string_view>
+
+// Redis-style glob matching: * ? [abc] [^a-z] and \ escapes. Never allocates, and
+// backtracks only to the last '*', so it stays linear-ish even on long keys.
+bool glob_match(std::string_view pattern, std::string_view str) noexcept;
+
+// True if pattern has no special characters, i.e. it only matches itself
+bool glob_is_literal(std::string_view pattern) noexcept;
+
+#endif
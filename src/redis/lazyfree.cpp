@@ -0,0 +1,63 @@
+#include "lazyfree.h"
+
+LazyFree::LazyFree() : worker([this] { run(); }) {
+}
+
+LazyFree::~LazyFree() {
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        stopping = true;
+    }
+    jobs_cv.notify_one();
+    worker.join();
+}
+
+void LazyFree::release(StorageEntry&& entry) noexcept {
+    if (entry.freeEffort() <= LAZYFREE_THRESHOLD) {
+        StorageEntry dying = std::move(entry); // destroyed at end of scope, on the caller's thread
+        return;
+    }
+    const size_t bytes = entry.estimatedBytes();
+    enqueue(Job{std::move(entry), 1, bytes});
+}
+
+void LazyFree::release(Keyspace&& keyspace) noexcept {
+    if (keyspace.empty()) return;
+    // O(keys) but cheap next to freeing them, and the keyspace is already detached from storage
+    size_t bytes = 0;
+    for (const auto& [key, entry] : keyspace)
+        bytes += string_heap_bytes(key) + entry.estimatedBytes();
+    const size_t objects = keyspace.size();
+    enqueue(Job{std::move(keyspace), objects, bytes});
+}
+
+void LazyFree::enqueue(Job job) noexcept {
+    pending_objects_count += job.objects;
+    pending_bytes_count += job.bytes;
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobs_cv.notify_one();
+}
+
+void LazyFree::run() noexcept {
+    std::unique_lock<std::mutex> lock(jobs_mutex);
+    while (true) {
+        jobs_cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty()) return; // stopping and drained
+
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        lock.unlock();
+
+        const size_t objects = job.objects;
+        const size_t bytes = job.bytes;
+        job.value = StorageEntry{}; // the actual free, outside the queue lock
+        pending_objects_count -= objects;
+        pending_bytes_count -= bytes;
+        freed_objects_count += objects;
+
+        lock.lock();
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef LAZYFREE_H
+#define LAZYFREE_H
+
+#include "storage.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <variant>
+
+// Background reclamation of detached values, so destroying a huge list or a whole
+// keyspace never happens while storage_mutex is held.
+class LazyFree {
+public:
+    // Values that free fewer allocations than this are cheaper to destroy inline
+    static constexpr size_t LAZYFREE_THRESHOLD = 64;
+
+    LazyFree();
+    ~LazyFree();
+    LazyFree(const LazyFree&) = delete;
+    LazyFree& operator=(const LazyFree&) = delete;
+
+    // Takes ownership of a value removed from storage; frees it right away if it is
+    // small, otherwise queues it for the background thread
+    void release(StorageEntry&& entry) noexcept;
+    // Always freed in the background (FLUSHALL ASYNC)
+    void release(Keyspace&& keyspace) noexcept;
+
+    size_t pending_objects() const noexcept { return pending_objects_count; }
+    size_t pending_bytes() const noexcept { return pending_bytes_count; }
+    size_t freed_objects() const noexcept { return freed_objects_count; }
+
+private:
+    struct Job {
+        std::variant<StorageEntry, Keyspace> value;
+        size_t objects;
+        size_t bytes;
+    };
+
+    void enqueue(Job job) noexcept;
+    void run() noexcept;
+
+    std::deque<Job> jobs;
+    std::mutex jobs_mutex; // protects jobs and stopping
+    std::condition_variable jobs_cv;
+    bool stopping = false;
+
+    std::atomic<size_t> pending_objects_count{0};
+    std::atomic<size_t> pending_bytes_count{0};
+    std::atomic<size_t> freed_objects_count{0};
+
+    std::thread worker; // declared last so everything above exists before it starts
+};
+
+#endif
@@ -0,0 +1,20 @@
+#include "memory.h"
+
+#include <cstdio>
+#include <malloc.h>
+#include <unistd.h>
+
+size_t allocated_bytes() noexcept {
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+size_t resident_bytes() noexcept {
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    unsigned long size = 0, resident = 0;
+    const int read = std::fscanf(statm, "%lu %lu", &size, &resident);
+    std::fclose(statm);
+    if (read != 2) return 0;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
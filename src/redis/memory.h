@@ -0,0 +1,24 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+#include <string>
+
+// Bytes the allocator really hands out for a request of n bytes. Models glibc malloc on
+// 64-bit: an 8 byte chunk header, 16 byte alignment and a 32 byte minimum chunk.
+constexpr size_t malloc_size(size_t n) noexcept {
+    const size_t chunk = (n + 8 + 15) & ~size_t{15};
+    return chunk < 32 ? 32 : chunk;
+}
+
+// Heap bytes behind a string, 0 while it fits in the small string buffer
+inline size_t string_heap_bytes(const std::string& str) noexcept {
+    static const size_t inline_capacity = std::string().capacity();
+    return str.capacity() > inline_capacity ? malloc_size(str.capacity() + 1) : 0;
+}
+
+// Process-wide figures, sampled from the allocator and the kernel
+size_t allocated_bytes() noexcept; // live heap, including large mmap()ed blocks
+size_t resident_bytes() noexcept;  // RSS, 0 if unavailable
+
+#endif
@@ -0,0 +1,94 @@
+#include "pubsub.h"
+#include "glob.h"
+
+bool PubSub::subscribe(uint64_t client_id, int protocol, const std::string& channel) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return channels[channel].emplace(client_id, protocol).second;
+}
+
+bool PubSub::unsubscribe(uint64_t client_id, const std::string& channel) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = channels.find(channel);
+    if (it == channels.end() || it->second.erase(client_id) == 0) return false;
+    if (it->second.empty()) channels.erase(it);
+    return true;
+}
+
+bool PubSub::psubscribe(uint64_t client_id, int protocol, const std::string& pattern) {
+    std::lock_guard<std::mutex> lock(mutex);
+    TrieNode* node = &pattern_root;
+    for (char c : literal_prefix(pattern)) {
+        auto& child = node->children[c];
+        if (!child) child = std::make_unique<TrieNode>();
+        node = child.get();
+    }
+    return node->patterns[pattern].emplace(client_id, protocol).second;
+}
+
+bool PubSub::punsubscribe(uint64_t client_id, const std::string& pattern) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::string prefix = literal_prefix(pattern);
+
+    // Remember the path so nodes left empty can be pruned bottom-up
+    std::vector<TrieNode*> path{&pattern_root};
+    for (char c : prefix) {
+        auto it = path.back()->children.find(c);
+        if (it == path.back()->children.end()) return false;
+        path.push_back(it->second.get());
+    }
+
+    auto& patterns = path.back()->patterns;
+    auto it = patterns.find(pattern);
+    if (it == patterns.end() || it->second.erase(client_id) == 0) return false;
+    if (it->second.empty()) patterns.erase(it);
+
+    for (size_t depth = prefix.size(); depth > 0; --depth) {
+        TrieNode* node = path[depth];
+        if (!node->patterns.empty() || !node->children.empty()) break;
+        path[depth - 1]->children.erase(prefix[depth - 1]);
+    }
+    return true;
+}
+
+size_t PubSub::publish(const std::string& channel, const std::string& message, const DeliverFunc& deliver) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t receivers = 0;
+
+    auto it = channels.find(channel);
+    if (it != channels.end()) {
+        Resp msg = Resp::push({Resp::bulkString("message"), Resp::bulkString(channel), Resp::bulkString(message)});
+        receivers += deliver_to(it->second, msg, deliver);
+    }
+
+    // Only the nodes along the channel's own characters can hold matching patterns
+    const TrieNode* node = &pattern_root;
+    for (size_t i{0}; node; ++i) {
+        for (const auto& [pattern, subscribers] : node->patterns) {
+            if (!glob_match(pattern, channel)) continue;
+            Resp msg = Resp::push({Resp::bulkString("pmessage"), Resp::bulkString(pattern),
+                                   Resp::bulkString(channel), Resp::bulkString(message)});
+            receivers += deliver_to(subscribers, msg, deliver);
+        }
+        if (i == channel.size()) break;
+        auto child = node->children.find(channel[i]);
+        node = child == node->children.end() ? nullptr : child->second.get();
+    }
+    return receivers;
+}
+
+std::string PubSub::literal_prefix(const std::string& pattern) {
+    return pattern.substr(0, pattern.find_first_of("*?[\\"));
+}
+
+// Encodes msg at most once per RESP version and hands each encoding to its subscribers
+size_t PubSub::deliver_to(const Subscribers& subscribers, const Resp& msg, const DeliverFunc& deliver) {
+    std::vector<uint64_t> resp2_ids, resp3_ids;
+    for (const auto& [id, protocol] : subscribers)
+        (protocol >= 3 ? resp3_ids : resp2_ids).push_back(id);
+
+    if (!resp2_ids.empty())
+        deliver(resp2_ids, std::make_shared<const std::string>(msg.encode(2)));
+    if (!resp3_ids.empty())
+        deliver(resp3_ids, std::make_shared<const std::string>(msg.encode(3)));
+    return subscribers.size();
+}
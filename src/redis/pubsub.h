@@ -0,0 +1,53 @@
+#ifndef PUBSUB_H
+#define PUBSUB_H
+
+#include "../resp/resp.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Channel and pattern subscriptions. A published message is encoded once per RESP
+ * version in use and the same buffer is handed out for every receiver.
+ */
+class PubSub {
+public:
+    // Queues one shared, already encoded message onto the output of every listed client
+    using DeliverFunc = std::function<void(const std::vector<uint64_t>& client_ids,
+                                           std::shared_ptr<const std::string> payload)>;
+
+    // Both return false if the client was already (un)subscribed
+    bool subscribe(uint64_t client_id, int protocol, const std::string& channel);
+    bool unsubscribe(uint64_t client_id, const std::string& channel);
+    bool psubscribe(uint64_t client_id, int protocol, const std::string& pattern);
+    bool punsubscribe(uint64_t client_id, const std::string& pattern);
+
+    // Returns the number of clients that received the message
+    size_t publish(const std::string& channel, const std::string& message, const DeliverFunc& deliver);
+
+private:
+    // client id -> RESP version the message must be encoded with
+    using Subscribers = std::unordered_map<uint64_t, int>;
+
+    // Patterns are stored at the node of their literal prefix (everything before the
+    // first glob character), so a channel is only matched against patterns whose prefix
+    // it starts with instead of against every pattern.
+    struct TrieNode {
+        std::unordered_map<char, std::unique_ptr<TrieNode>> children;
+        std::unordered_map<std::string, Subscribers> patterns;
+    };
+
+    static std::string literal_prefix(const std::string& pattern);
+    static size_t deliver_to(const Subscribers& subscribers, const Resp& msg, const DeliverFunc& deliver);
+
+    std::unordered_map<std::string, Subscribers> channels;
+    TrieNode pattern_root;
+    std::mutex mutex; // protects channels and pattern_root
+};
+
+#endif
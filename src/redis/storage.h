@@ -7,20 +7,44 @@
 #include <variant>
 #include <deque> 
 #include <string>
+#include <cstdint>
+#include <algorithm>
+#include <random>
+
+#include "dict.h"
+#include "memory.h"
 
 using StringList = std::deque<std::string>;
 
-enum class StorageType {
+enum class StorageType : uint8_t {
     String,
     List,
     // Future: Set, ZSet, Hash, Stream, etc.
 };
 
+// Seconds on the steady clock, the time base of StorageEntry::access_time
+inline uint32_t access_clock() noexcept {
+    using namespace std::chrono;
+    return static_cast<uint32_t>(duration_cast<seconds>(steady_clock::now().time_since_epoch()).count());
+}
+
 struct StorageEntry {
+    // Access frequency counter (OBJECT FREQ), Redis' logarithmic LFU: new keys start at
+    // LFU_INIT_VAL, each access increments with probability 1 / ((freq - LFU_INIT_VAL) * LFU_LOG_FACTOR + 1),
+    // and the counter decays by one for every LFU_DECAY_SECONDS without access
+    static constexpr uint8_t LFU_INIT_VAL = 5;
+    static constexpr double LFU_LOG_FACTOR = 10;
+    static constexpr uint32_t LFU_DECAY_SECONDS = 60;
+    // libstdc++ deques store elements in fixed 512 byte blocks
+    static constexpr size_t DEQUE_BLOCK_BYTES = 512;
+
     std::variant<std::string, StringList> value;
     StorageType type = StorageType::String;
+    // Fit in the padding after type, so access tracking costs no memory per key
+    uint8_t freq = LFU_INIT_VAL;
+    uint32_t access_time = access_clock(); // last read or write, for OBJECT IDLETIME
     std::optional<std::chrono::time_point<std::chrono::steady_clock>> expiry;
-    
+    uint64_t version = 0; // bumped on every write, compared by WATCH
 
     /*
     bool isString() {
@@ -31,7 +55,7 @@ struct StorageEntry {
     }
     */
 
-    std::string getTypeName() {
+    std::string getTypeName() const {
         switch(type) {
             case StorageType::String:
                 return "string";
@@ -42,7 +66,7 @@ struct StorageEntry {
         }
     }
 
-    bool isExpired() {
+    bool isExpired() const {
         return expiry.has_value() && std::chrono::steady_clock::now() > *expiry;
     }
 
@@ -56,6 +80,63 @@ struct StorageEntry {
         return std::get<StringList>(value);
     }
 
+    // Number of allocations released when the value is destroyed
+    size_t freeEffort() const {
+        if (type == StorageType::List) return std::get<StringList>(value).size();
+        return 1;
+    }
+
+    /**
+     * Heap bytes held by the value, allocator overhead included. Lists add their deque
+     * blocks and block map, plus element strings estimated from the first samples
+     * elements (all of them if samples is 0), so the default stays O(1).
+     */
+    size_t estimatedBytes(const size_t samples = 5) const {
+        if (type == StorageType::String) return string_heap_bytes(std::get<std::string>(value));
+        const StringList& list = std::get<StringList>(value);
+        constexpr size_t per_block = DEQUE_BLOCK_BYTES / sizeof(std::string);
+        const size_t blocks = list.size() / per_block + 1;
+        size_t bytes = blocks * malloc_size(DEQUE_BLOCK_BYTES) + malloc_size(sizeof(void*) * std::max<size_t>(8, blocks + 2));
+        if (list.empty()) return bytes;
+
+        const size_t sampled = samples == 0 ? list.size() : std::min(samples, list.size());
+        size_t elements = 0;
+        for (size_t i{0}; i < sampled; ++i) elements += string_heap_bytes(list[i]);
+        return bytes + elements * list.size() / sampled;
+    }
+
+    // Seconds since the last read or write (OBJECT IDLETIME)
+    uint32_t idleSeconds(const uint32_t now = access_clock()) const {
+        return now > access_time ? now - access_time : 0;
+    }
+
+    // The frequency counter after decay, without recording an access
+    uint8_t decayedFreq(const uint32_t now = access_clock()) const {
+        const uint32_t periods = idleSeconds(now) / LFU_DECAY_SECONDS;
+        return periods >= freq ? 0 : freq - periods;
+    }
+
+    void recordAccess(const uint32_t now = access_clock()) {
+        static thread_local std::minstd_rand rng{std::random_device{}()};
+        freq = decayedFreq(now);
+        if (freq < 255) {
+            const double base = freq > LFU_INIT_VAL ? freq - LFU_INIT_VAL : 0;
+            if (std::uniform_real_distribution<double>(0, 1)(rng) < 1.0 / (base * LFU_LOG_FACTOR + 1)) ++freq;
+        }
+        access_time = now;
+    }
+
+    // OBJECT ENCODING. Strings are "embstr" while they fit in std::string's inline buffer
+    // and "raw" once they have a heap allocation; lists are a deque of fixed size blocks,
+    // the same shape as a quicklist.
+    const char* encodingName() const {
+        if (type == StorageType::List) return "quicklist";
+        const std::string& str = std::get<std::string>(value);
+        return string_heap_bytes(str) == 0 ? "embstr" : "raw";
+    }
+
 };
 
+using Keyspace = Dict<StorageEntry>;
+
 #endif
\ No newline at end of file
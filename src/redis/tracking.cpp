@@ -0,0 +1,98 @@
+#include "tracking.h"
+
+#include <algorithm>
+
+void TrackingTable::enable(uint64_t client_id, bool bcast, std::vector<std::string> prefixes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [it, inserted] = trackers.try_emplace(client_id, Tracker{bcast, {}, {}});
+    // Reads recorded in default mode mean nothing to a BCAST tracker
+    if (!inserted && bcast) {
+        for (const auto& key : it->second.keys) {
+            auto readers_it = key_readers.find(key);
+            readers_it->second.erase(client_id);
+            if (readers_it->second.empty()) key_readers.erase(readers_it);
+        }
+        it->second.keys.clear();
+    }
+    it->second.bcast = bcast;
+    it->second.prefixes = std::move(prefixes);
+}
+
+void TrackingTable::disable(uint64_t client_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = trackers.find(client_id);
+    if (it == trackers.end()) return;
+    for (const auto& key : it->second.keys) {
+        auto readers_it = key_readers.find(key);
+        readers_it->second.erase(client_id);
+        if (readers_it->second.empty()) key_readers.erase(readers_it);
+    }
+    trackers.erase(it);
+}
+
+std::vector<TrackingTable::Invalidation> TrackingTable::record_read(uint64_t client_id, const std::string& key) {
+    std::vector<Invalidation> evicted;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = trackers.find(client_id);
+    if (it == trackers.end() || it->second.bcast) return evicted;
+    key_readers[key].insert(client_id);
+    it->second.keys.insert(key);
+
+    // Like Redis the evicted keys are arbitrary, only the one just read is kept
+    while (max_tracked_keys && key_readers.size() > max_tracked_keys) {
+        auto victim = key_readers.begin();
+        if (victim->first == key) ++victim;
+        std::string victim_key = victim->first;
+        evicted.emplace_back(victim_key, take_readers(victim_key));
+    }
+    return evicted;
+}
+
+std::vector<uint64_t> TrackingTable::invalidate(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Default mode is one-shot: a client has to read the key again to hear about the next change
+    std::vector<uint64_t> ids = take_readers(key);
+
+    for (const auto& [id, tracker] : trackers) {
+        if (!tracker.bcast) continue;
+        bool matches = tracker.prefixes.empty() || std::any_of(tracker.prefixes.begin(), tracker.prefixes.end(),
+            [&](const std::string& prefix) { return key.starts_with(prefix); });
+        if (matches) ids.push_back(id);
+    }
+    return ids;
+}
+
+std::vector<uint64_t> TrackingTable::invalidate_all() {
+    std::vector<uint64_t> ids;
+    std::lock_guard<std::mutex> lock(mutex);
+    key_readers.clear();
+    for (auto& [id, tracker] : trackers) {
+        tracker.keys.clear();
+        ids.push_back(id);
+    }
+    return ids;
+}
+
+size_t TrackingTable::max_keys() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return max_tracked_keys;
+}
+
+void TrackingTable::set_max_keys(size_t max) {
+    std::lock_guard<std::mutex> lock(mutex);
+    max_tracked_keys = max;
+}
+
+// Caller must hold mutex
+std::vector<uint64_t> TrackingTable::take_readers(const std::string& key) {
+    std::vector<uint64_t> ids;
+    auto readers_it = key_readers.find(key);
+    if (readers_it == key_readers.end()) return ids;
+    for (uint64_t id : readers_it->second) {
+        auto it = trackers.find(id);
+        if (it != trackers.end()) it->second.keys.erase(key);
+        ids.push_back(id);
+    }
+    key_readers.erase(readers_it);
+    return ids;
+}
@@ -0,0 +1,53 @@
+#ifndef TRACKING_H
+#define TRACKING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Server side of client-side caching (CLIENT TRACKING): remembers which clients may
+// have cached which keys and tells the caller whom to notify when a key changes.
+class TrackingTable {
+public:
+    // A key and the ids of the clients to notify that it changed
+    using Invalidation = std::pair<std::string, std::vector<uint64_t>>;
+
+    // Default mode tracks the keys a client reads, BCAST mode tracks key prefixes
+    // (an empty prefix list means every key).
+    void enable(uint64_t client_id, bool bcast, std::vector<std::string> prefixes);
+    // Forgets the client and every key it read
+    void disable(uint64_t client_id);
+    // Once more than max_keys keys are tracked, other keys are evicted and returned:
+    // their readers have to be told, since a later change would go unnoticed
+    std::vector<Invalidation> record_read(uint64_t client_id, const std::string& key);
+    // Returns the ids of the clients to notify that key was modified
+    std::vector<uint64_t> invalidate(const std::string& key);
+    // Every key is gone (FLUSHALL): returns the ids of all tracking clients
+    std::vector<uint64_t> invalidate_all();
+
+    // tracking-table-max-keys, 0 for no limit
+    size_t max_keys();
+    void set_max_keys(size_t max);
+
+private:
+    struct Tracker {
+        bool bcast;
+        std::vector<std::string> prefixes;
+        std::unordered_set<std::string> keys; // default mode: keys read since their last invalidation
+    };
+    // Drops key from key_readers and from the key set of each of its readers, returning them
+    std::vector<uint64_t> take_readers(const std::string& key);
+
+    std::unordered_map<uint64_t, Tracker> trackers;
+    // Readers of a key since its last invalidation, the reverse of Tracker::keys
+    std::unordered_map<std::string, std::unordered_set<uint64_t>> key_readers;
+    size_t max_tracked_keys = 1000000;
+    std::mutex mutex;
+};
+
+#endif
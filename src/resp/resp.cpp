@@ -1,6 +1,10 @@
 #include "resp.h"
+
 #include <cctype>
+#include <limits>
 #include <stdexcept>
+#include <charconv>
+#include <cmath>
 
 /* ----------------------------- Resp FUNCTIONS --------------------------*/
 Resp Resp::simpleString(std::string s) {
@@ -15,7 +19,7 @@ Resp Resp::error(std::string s) {
     r.type = RespType::Error;
     return r;
 }
-Resp Resp::integer(const int i) {
+Resp Resp::integer(const int64_t i) {
     Resp r;
     r.value = i;
     r.type = RespType::Integer;
@@ -43,9 +47,60 @@ Resp Resp::nullArray() {
     r.type = RespType::NullArray;
     return r;
 }
+Resp Resp::map(RespVec kv) {
+    Resp r;
+    r.value = std::move(kv);
+    r.type = RespType::Map;
+    return r;
+}
+Resp Resp::set(RespVec arr) {
+    Resp r;
+    r.value = std::move(arr);
+    r.type = RespType::Set;
+    return r;
+}
+Resp Resp::doubleValue(const double d) {
+    Resp r;
+    r.value = d;
+    r.type = RespType::Double;
+    return r;
+}
+Resp Resp::boolean(const bool b) {
+    Resp r;
+    r.value = b;
+    r.type = RespType::Boolean;
+    return r;
+}
+Resp Resp::null() {
+    Resp r;
+    r.type = RespType::Null;
+    return r;
+}
+Resp Resp::push(RespVec arr) {
+    Resp r;
+    r.value = std::move(arr);
+    r.type = RespType::Push;
+    return r;
+}
 
+// Shortest round-trippable representation, "inf"/"-inf"/"nan" for the special values
+static std::string formatDouble(const double d) {
+    char buf[32];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), d);
+    return std::string(buf, end);
+}
 
-std::string Resp::encode() const {
+static std::string encodeAggregate(const char prefix, const RespVec& arr, const size_t len, const int protocol) {
+    std::string res = prefix + std::to_string(len) + "\r\n";
+    for (auto& el : arr) {
+        res += el.encode(protocol);
+    }
+    return res;
+}
+
+
+std::string Resp::encode(const int protocol) const {
+    const bool resp3 = protocol >= 3;
     switch(type) {
         case RespType::SimpleString:
             return "+" + this->asString() + "\r\n";
@@ -58,40 +113,72 @@ std::string Resp::encode() const {
         case RespType::Integer:
             return ":" + std::to_string(this->asInt()) + "\r\n";
         case RespType::NullBS:
-            return "$-1\r\n";
+            return resp3 ? "_\r\n" : "$-1\r\n";
         case RespType::Array: {
             auto& arr = this->asArray();
-            std::string res = "*" + std::to_string(arr.size()) + "\r\n";
-            for (auto& el : arr) {
-                res += el.encode();
-            }
-            return res;
+            return encodeAggregate('*', arr, arr.size(), protocol);
+        }
+        case RespType::Map: {
+            auto& kv = this->asArray();
+            // RESP2 has no maps, send the flat key/value array instead
+            return resp3 ? encodeAggregate('%', kv, kv.size() / 2, protocol)
+                         : encodeAggregate('*', kv, kv.size(), protocol);
+        }
+        case RespType::Set: {
+            auto& arr = this->asArray();
+            return encodeAggregate(resp3 ? '~' : '*', arr, arr.size(), protocol);
+        }
+        case RespType::Push: {
+            auto& arr = this->asArray();
+            return encodeAggregate(resp3 ? '>' : '*', arr, arr.size(), protocol);
         }
+        case RespType::Double: {
+            const std::string str = formatDouble(this->asDouble());
+            if (resp3) return "," + str + "\r\n";
+            return "$" + std::to_string(str.length()) + "\r\n" + str + "\r\n";
+        }
+        case RespType::Boolean:
+            if (resp3) return this->asBool() ? "#t\r\n" : "#f\r\n";
+            return this->asBool() ? ":1\r\n" : ":0\r\n";
+        case RespType::Null:
+            return resp3 ? "_\r\n" : "$-1\r\n";
         default:
-            return "*-1\r\n";
+            return resp3 ? "_\r\n" : "*-1\r\n";
     }
 }
 
 // Return RESP error, simple string, and bulk string types as a string
 const std::string& Resp::asString() const {
-    if (type == RespType::Integer || type == RespType::Array) {
+    if (!std::holds_alternative<std::string>(value)) {
         throw std::runtime_error("Invalid RESP type, expected string");
     }
     return std::get<std::string>(value);
 }
 
 const RespVec& Resp::asArray() const {
-    if (type != RespType::Array)
+    if (type != RespType::Array && type != RespType::Map && type != RespType::Set && type != RespType::Push)
         throw std::runtime_error("Invalid RESP type, expected array");
     return std::get<RespVec>(value);
 }
 
-int Resp::asInt() const {
+int64_t Resp::asInt() const {
     if (type != RespType::Integer)
         throw std::runtime_error("Invalid RESP type, expected int");
     return std::get<int64_t>(value);
 }
 
+double Resp::asDouble() const {
+    if (type != RespType::Double)
+        throw std::runtime_error("Invalid RESP type, expected double");
+    return std::get<double>(value);
+}
+
+bool Resp::asBool() const {
+    if (type != RespType::Boolean)
+        throw std::runtime_error("Invalid RESP type, expected boolean");
+    return std::get<bool>(value);
+}
+
 /* ------------------------- RespParser functions ------------ */
 bool RespParser::expectCRLF() {
     if (pos + 1 >= data.size() || data[pos] != '\r' || data[pos + 1] != '\n') {
@@ -112,7 +199,9 @@ std::optional<int> RespParser::readInt(bool posOk) {
 
     int num {0};
     while (pos < data.size() && std::isdigit(data[pos])) {
-        num = num * 10 + data[pos++] - '0';
+        const int digit = data[pos++] - '0';
+        if (num > (std::numeric_limits<int>::max() - digit) / 10) return std::nullopt; // would overflow
+        num = num * 10 + digit;
     }
     if (!expectCRLF()) return std::nullopt;
     return isNeg ? num * -1 : num;
@@ -143,15 +232,14 @@ std::optional<Resp> RespParser::parseBulkString() {
     auto len = readInt(false);
     if (!len) return std::nullopt;
     if (*len == -1) return Resp::nullBulkString();
+    if (*len < -1) return std::nullopt;
 
-    // Process the actual string
-    std::string str{};
-    for (size_t i{0}; i < *len; ++i) {
-        if (pos >= data.size()) break;
-        str.push_back(data[pos++]);
-    }
+    // Process the actual string, copied in one go since values can be large
+    if (pos + *len > data.size()) return std::nullopt;
+    std::string str(data.begin() + pos, data.begin() + pos + *len);
+    pos += *len;
 
-    if (str.length() != *len || !expectCRLF()) return std::nullopt;
+    if (!expectCRLF()) return std::nullopt;
 
     return Resp::bulkString(std::move(str));
 }
@@ -167,34 +255,87 @@ std::optional<Resp> RespParser::parseSimpleString() {
     return Resp::simpleString(std::move(str));
 }
 
-std::optional<Resp> RespParser::parseArray() {
+std::optional<std::string> RespParser::readLine() {
+    std::string line{};
+    while (pos < data.size() && data[pos] != '\r') {
+        line.push_back(data[pos++]);
+    }
+    if (!expectCRLF()) return std::nullopt;
+    return line;
+}
+
+std::optional<Resp> RespParser::parseDouble() {
+    if (++pos >= data.size()) return std::nullopt;
+    auto line = readLine();
+    if (!line || line->empty()) return std::nullopt;
+
+    if (*line == "inf") return Resp::doubleValue(INFINITY);
+    if (*line == "-inf") return Resp::doubleValue(-INFINITY);
+    if (*line == "nan") return Resp::doubleValue(NAN);
+    double d{};
+    auto [end, ec] = std::from_chars(line->data(), line->data() + line->size(), d);
+    if (ec != std::errc() || end != line->data() + line->size()) return std::nullopt;
+    return Resp::doubleValue(d);
+}
+
+std::optional<Resp> RespParser::parseBoolean() {
+    if (++pos >= data.size()) return std::nullopt;
+    auto line = readLine();
+    if (!line || (*line != "t" && *line != "f")) return std::nullopt;
+    return Resp::boolean(*line == "t");
+}
+
+std::optional<Resp> RespParser::parseNull() {
+    ++pos;
+    if (!expectCRLF()) return std::nullopt;
+    return Resp::null();
+}
+
+// Parses arrays, maps, sets and pushes, which differ only in their prefix and element count
+std::optional<Resp> RespParser::parseAggregate(RespType type) {
     if (++pos >= data.size()) return std::nullopt;
     auto len = readInt(false);
     if (!len || *len < -1) return std::nullopt;
+    if (*len == -1) {
+        if (type != RespType::Array) return std::nullopt;
+        return Resp::nullArray();
+    }
     
+    const size_t count = type == RespType::Map ? static_cast<size_t>(*len) * 2 : static_cast<size_t>(*len);
+    // The count comes from the peer: every element takes at least 3 bytes ("_\r\n"), so a
+    // count the remaining input can't hold is rejected before anything is allocated
+    if (count > (data.size() - pos) / 3) return std::nullopt;
     RespVec arr;
-    arr.reserve(*len);
-    for (size_t i {0}; i < *len; ++i) {
+    arr.reserve(count);
+    for (size_t i {0}; i < count; ++i) {
         if (pos >= data.size()) return std::nullopt;
         std::optional<Resp> r {parse()};
         if (!r) return std::nullopt;
-        arr.push_back(*r);
+        arr.push_back(std::move(*r));
     }
 
-    if (*len != arr.size()) return std::nullopt;
-
-    return Resp::array(std::move(arr));
-
+    switch (type) {
+        case RespType::Map: return Resp::map(std::move(arr));
+        case RespType::Set: return Resp::set(std::move(arr));
+        case RespType::Push: return Resp::push(std::move(arr));
+        default: return Resp::array(std::move(arr));
+    }
 }
 
 std::optional<Resp> RespParser::parse() {
     if (pos >= data.size()) return std::nullopt;
     switch (data[pos]) {
-        case '*': return parseArray();
+        case '*': return parseAggregate(RespType::Array);
+        case '%': return parseAggregate(RespType::Map);
+        case '~': return parseAggregate(RespType::Set);
+        case '>': return parseAggregate(RespType::Push);
         case '$': return parseBulkString();
         case '+': return parseSimpleString();
         case '-': return parseError();
         case ':': return parseInt();
+        case ',': return parseDouble();
+        case '#': return parseBoolean();
+        case '_': return parseNull();
         default:  return std::nullopt;
     }
 }
\ No newline at end of file
@@ -19,6 +19,13 @@ enum class RespType {
     Array,
     NullBS,
     NullArray,
+    // RESP3 only, downgraded to the nearest RESP2 type when encoding for protocol 2
+    Map,     // %<pairs>\r\n<key><value>...  stored flat as k1, v1, k2, v2...
+    Set,     // ~<length>\r\n<elements>
+    Double,  // ,<floating point>\r\n
+    Boolean, // #t\r\n or #f\r\n
+    Null,    // _\r\n
+    Push,    // ><length>\r\n<elements>, out-of-band data such as invalidations
 };
 
 class Resp {
@@ -26,6 +33,8 @@ private:
     std::variant<
         std::string,
         int64_t,
+        double,
+        bool,
         RespVec
     > value;
 
@@ -35,25 +44,36 @@ public:
     // TODO: determine if its better to PBR or PBV here
     static Resp simpleString(std::string s);
     static Resp error(std::string s);
-    static Resp integer(const int i);
+    static Resp integer(const int64_t i);
     static Resp bulkString(std::string s);
     static Resp array(RespVec arr);
     static Resp nullBulkString();
     static Resp nullArray();
+    static Resp map(RespVec kv);
+    static Resp set(RespVec arr);
+    static Resp doubleValue(const double d);
+    static Resp boolean(const bool b);
+    static Resp null();
+    static Resp push(RespVec arr);
     
-    // Encode to RESP format
-    std::string encode() const;
+    // Encode to RESP format, protocol is the version negotiated with HELLO (2 or 3)
+    std::string encode(const int protocol = 2) const;
     
     const std::string& asString() const;
-    const RespVec& asArray() const;
-    int asInt() const;
+    const RespVec& asArray() const; // also valid for Map, Set and Push
+    int64_t asInt() const;
+    double asDouble() const;
+    bool asBool() const;
 };
 
 class RespParser {
     const std::vector<u8>& data{};
     size_t pos = 0;
 
-    std::optional<Resp> parseArray();
+    std::optional<Resp> parseAggregate(RespType type);
+    std::optional<Resp> parseDouble();
+    std::optional<Resp> parseBoolean();
+    std::optional<Resp> parseNull();
     std::optional<Resp> parseInt();
     std::optional<Resp> parseError();
     std::optional<Resp> parseBulkString();
@@ -61,6 +81,7 @@ class RespParser {
 
     bool expectCRLF();
     std::optional<int> readInt(bool posOk=true);
+    std::optional<std::string> readLine();
 
 public:
     RespParser(const std::vector<u8>& bytes) : data{bytes}